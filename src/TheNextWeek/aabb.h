@@ -3,32 +3,37 @@
 
 #include "rtweekend.h"
 
-class aabb
+// 轴对齐包围盒，按标量类型 T 模板化；渲染器用的是 aabb = basic_aabb<real>
+template <typename T>
+class basic_aabb
 {
 public:
-    interval x, y, z;
-    aabb() {} // empty default constructor
-    aabb(const interval &x, const interval &y, const interval &z)
+    typedef basic_interval<T> interval_type;
+    typedef basic_vec3<T> point_type;
+
+    interval_type x, y, z;
+    basic_aabb() {} // empty default constructor
+    basic_aabb(const interval_type &x, const interval_type &y, const interval_type &z)
         : x(x), y(y), z(z) { pad_to_minimuns(); }
 
-    aabb(const point3 &a, const point3 &b)
+    basic_aabb(const point_type &a, const point_type &b)
     {
         // order the points
-        x = (a[0] <= b[0]) ? interval(a[0], b[0]) : interval(b[0], a[0]);
-        y = (a[1] <= b[1]) ? interval(a[1], b[1]) : interval(b[1], a[1]);
-        z = (a[2] <= b[2]) ? interval(a[2], b[2]) : interval(b[2], a[2]);
+        x = (a[0] <= b[0]) ? interval_type(a[0], b[0]) : interval_type(b[0], a[0]);
+        y = (a[1] <= b[1]) ? interval_type(a[1], b[1]) : interval_type(b[1], a[1]);
+        z = (a[2] <= b[2]) ? interval_type(a[2], b[2]) : interval_type(b[2], a[2]);
 
         pad_to_minimuns();
     }
 
-    aabb(const aabb &box1, const aabb &box2)
+    basic_aabb(const basic_aabb &box1, const basic_aabb &box2)
     {
-        x = interval(box1.x, box2.x);
-        y = interval(box1.y, box2.y);
-        z = interval(box1.z, box2.z);
+        x = interval_type(box1.x, box2.x);
+        y = interval_type(box1.y, box2.y);
+        z = interval_type(box1.z, box2.z);
     }
 
-    const interval &axis_interval(int n) const
+    const interval_type &axis_interval(int n) const
     {
         switch (n)
         {
@@ -43,30 +48,31 @@ public:
             return x;
         }
     }
-    bool hit(const ray &r, interval ray_t) const
+    bool hit(const basic_ray<T> &r, interval_type ray_t) const
     {
-        const point3 &ray_ori = r.origin();
-        const vec3 &ray_dir = r.direction();
+        RT_STAT(thread_stats().box_tests++);
+        const point_type &ray_ori = r.origin();
+        const point_type &ray_dir = r.direction();
 
         for (int axis = 0; axis < 3; axis++)
         {
-            const interval &currAxis = axis_interval(axis);
-            const double adinv = 1.0 / ray_dir[axis];
+            const interval_type &currAxis = axis_interval(axis);
+            const T adinv = 1 / ray_dir[axis];
             auto t0 = (currAxis.min - ray_ori[axis]) * adinv;
             auto t1 = (currAxis.max - ray_ori[axis]) * adinv;
-            if (t0 > t1)
+            if (t0 < t1)
             {
                 if (t0 > ray_t.min)
                     ray_t.min = t0;
-                if (t1 < ray_t.max)
-                    ray_t.max = t1;
+                if (t1 * far_scale < ray_t.max)
+                    ray_t.max = t1 * far_scale;
             }
             else
             {
                 if (t1 > ray_t.min)
                     ray_t.min = t1;
-                if (t0 < ray_t.max)
-                    ray_t.max = t0;
+                if (t0 * far_scale < ray_t.max)
+                    ray_t.max = t0 * far_scale;
             }
             if (ray_t.max <= ray_t.min)
                 return false;
@@ -74,6 +80,18 @@ public:
         return true;
     }
 
+    // Surface area of the box, the probability measure used by the SAH builder.
+    T surface_area() const
+    {
+        auto dx = x.size(), dy = y.size(), dz = z.size();
+        return 2.0 * (dx * dy + dy * dz + dz * dx);
+    }
+
+    point_type centroid() const
+    {
+        return point_type(0.5 * (x.min + x.max), 0.5 * (y.min + y.max), 0.5 * (z.min + z.max));
+    }
+
     int longest_axis() const
     {
         // return the index of the longest axis
@@ -83,12 +101,16 @@ public:
             return y.size() > z.size() ? 1 : 2;
     }
 
-    static const aabb empty, universe;
+    static const basic_aabb empty, universe;
+
+    // Slab tests stretch the exit distance by 2γ(3) so the rounding of (bound - origin) * inv_dir
+    // never culls a box the ray grazes, which matters most in single precision (PBRT 3.9.2).
+    static constexpr T far_scale = 1 + 2 * 3 * (std::numeric_limits<T>::epsilon() / 2);
 
 private:
     void pad_to_minimuns()
     {
-        double delta = 0.0001;
+        T delta = T(0.0001);
         if (x.size() < delta)
             x = x.expand(delta);
         if (y.size() < delta)
@@ -98,15 +120,21 @@ private:
     }
 };
 
-const aabb aabb::empty = aabb(interval::empty, interval::empty, interval::empty);
-const aabb aabb::universe = aabb(interval::universe, interval::universe, interval::universe);
+template <typename T>
+const basic_aabb<T> basic_aabb<T>::empty = basic_aabb<T>(basic_interval<T>::empty, basic_interval<T>::empty, basic_interval<T>::empty);
+template <typename T>
+const basic_aabb<T> basic_aabb<T>::universe = basic_aabb<T>(basic_interval<T>::universe, basic_interval<T>::universe, basic_interval<T>::universe);
+
+typedef basic_aabb<real> aabb;
 
-aabb operator+(const aabb &bbox, const vec3 &offset)
+template <typename T>
+basic_aabb<T> operator+(const basic_aabb<T> &bbox, const basic_vec3<T> &offset)
 {
-    return aabb(bbox.x + offset.x(), bbox.y + offset.y(), bbox.z + offset.z());
+    return basic_aabb<T>(bbox.x + offset.x(), bbox.y + offset.y(), bbox.z + offset.z());
 }
 
-aabb operator+(const vec3 &offset, const aabb &bbox)
+template <typename T>
+basic_aabb<T> operator+(const basic_vec3<T> &offset, const basic_aabb<T> &bbox)
 {
     return bbox + offset;
 }
@@ -0,0 +1,186 @@
+#ifndef ACCUMULATION_BUFFER_H
+#define ACCUMULATION_BUFFER_H
+
+#include "rtweekend.h"
+#include "framebuffer.h"
+#include "pixel_estimate.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// 检查点文件头
+const char checkpoint_magic[4] = {'R', 'T', 'C', 'K'};
+const uint32_t checkpoint_version = 3;
+
+// 累积缓冲
+// Per-pixel sample statistics of a render in progress. Progressive rendering adds a pass of
+// samples at a time and resolves the buffer into a framebuffer for previews.
+//
+// It doubles as the checkpoint. The random generator is reseeded from (seed, pixel, sample,
+// bounce) at every path vertex and the samplers are pure functions of the same counters, so the
+// seed, the sampler and the number of samples taken are its whole state: a resumed render draws
+// exactly the numbers the interrupted one would have. The key stands for everything else the
+// image depends on (the scene and the camera's view and path settings), so a checkpoint left by
+// another render is never resumed.
+class accumulation_buffer
+{
+public:
+    int width = 0;
+    int height = 0;
+    uint64_t seed = 0;
+    uint32_t sequence = 0;              // 所用采样器（sampler_kind）
+    uint64_t key = 0;                   // 场景和相机设置的哈希，见 camera::checkpoint_key
+    int samples_done = 0;               // passes completed so far, in samples per pixel
+    std::vector<pixel_estimate> pixels; // row-major, indexed by pixel id j * width + i
+    std::vector<char> active;           // pixels adaptive sampling has not stopped yet
+
+    accumulation_buffer(int width, int height, uint64_t seed, uint32_t sequence, uint64_t key)
+        : width(width), height(height), seed(seed), sequence(sequence), key(key),
+          pixels(size_t(width) * height), active(size_t(width) * height, 1) {}
+
+    void resolve(framebuffer &image) const
+    {
+        image.resize(width, height);
+        for (int j = 0; j < height; j++)
+            for (int i = 0; i < width; i++)
+                image.set(i, j, pixels[size_t(j) * width + i].value());
+    }
+
+    uint64_t total_samples() const
+    {
+        uint64_t total = 0;
+        for (const auto &p : pixels)
+            total += p.count;
+        return total;
+    }
+
+    // Writes the checkpoint to a temporary file and renames it over `path`, so an interruption
+    // mid-write leaves the previous checkpoint intact.
+    bool save(const std::string &path) const
+    {
+        std::string temp = path + ".tmp";
+        {
+            std::ofstream out(temp, std::ios::binary);
+            if (!out)
+            {
+                std::cerr << "ERROR: Could not open '" << temp << "' for writing.\n";
+                return false;
+            }
+
+            out.write(checkpoint_magic, 4);
+            put(out, checkpoint_version);
+            put(out, int32_t(width));
+            put(out, int32_t(height));
+            put(out, seed);
+            put(out, sequence);
+            put(out, key);
+            put(out, int32_t(samples_done));
+            for (size_t p = 0; p < pixels.size(); p++)
+            {
+                const pixel_estimate &e = pixels[p];
+                put(out, double(e.sum.x())); // 两种精度的构建写同样的格式
+                put(out, double(e.sum.y()));
+                put(out, double(e.sum.z()));
+                put(out, e.luminance_mean());
+                put(out, e.luminance_m2());
+                put(out, int32_t(e.count));
+                put(out, uint8_t(active[p]));
+            }
+            if (!out)
+            {
+                std::cerr << "ERROR: Could not write checkpoint '" << temp << "'.\n";
+                return false;
+            }
+        }
+
+        std::remove(path.c_str()); // rename() does not replace an existing file on Windows
+        if (std::rename(temp.c_str(), path.c_str()) != 0)
+        {
+            std::cerr << "ERROR: Could not rename '" << temp << "' to '" << path << "'.\n";
+            return false;
+        }
+        return true;
+    }
+
+    // Restores a checkpoint written by save(). Returns false, leaving the buffer untouched, when
+    // the file is missing, damaged or belongs to a render with another size, seed, sampler or key.
+    bool load(const std::string &path)
+    {
+        std::ifstream in(path, std::ios::binary);
+        if (!in)
+            return false;
+
+        char file_magic[4];
+        uint32_t file_version = 0;
+        int32_t file_width = 0, file_height = 0, file_samples = 0;
+        uint64_t file_seed = 0;
+        uint32_t file_sequence = 0;
+        uint64_t file_key = 0;
+        in.read(file_magic, 4);
+        get(in, file_version);
+        get(in, file_width);
+        get(in, file_height);
+        get(in, file_seed);
+        get(in, file_sequence);
+        get(in, file_key);
+        get(in, file_samples);
+        if (!in || std::memcmp(file_magic, checkpoint_magic, 4) != 0 || file_version != checkpoint_version)
+        {
+            std::cerr << "WARNING: '" << path << "' is not a checkpoint this build can read; starting over.\n";
+            return false;
+        }
+        if (file_width != width || file_height != height || file_seed != seed || file_sequence != sequence)
+        {
+            std::cerr << "WARNING: checkpoint '" << path << "' is for a different image, seed or sampler; starting over.\n";
+            return false;
+        }
+        if (file_key != key)
+        {
+            std::cerr << "WARNING: checkpoint '" << path << "' is for a different scene or camera; starting over.\n";
+            return false;
+        }
+
+        std::vector<pixel_estimate> file_pixels(pixels.size());
+        std::vector<char> file_active(active.size());
+        for (size_t p = 0; p < file_pixels.size(); p++)
+        {
+            double r, g, b, mean, m2;
+            int32_t count;
+            uint8_t flag;
+            get(in, r);
+            get(in, g);
+            get(in, b);
+            get(in, mean);
+            get(in, m2);
+            get(in, count);
+            get(in, flag);
+            file_pixels[p] = pixel_estimate(color(r, g, b), count, mean, m2);
+            file_active[p] = char(flag);
+        }
+        if (!in)
+        {
+            std::cerr << "WARNING: checkpoint '" << path << "' is truncated; starting over.\n";
+            return false;
+        }
+
+        samples_done = file_samples;
+        pixels.swap(file_pixels);
+        active.swap(file_active);
+        return true;
+    }
+
+private:
+    // Fields are written in the host's byte order; a checkpoint only has to survive a restart on
+    // the same machine.
+    template <typename T>
+    static void put(std::ostream &out, T value) { out.write(reinterpret_cast<const char *>(&value), sizeof(T)); }
+
+    template <typename T>
+    static void get(std::istream &in, T &value) { in.read(reinterpret_cast<char *>(&value), sizeof(T)); }
+};
+
+#endif
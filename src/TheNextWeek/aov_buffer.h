@@ -0,0 +1,29 @@
+#ifndef AOV_BUFFER_H
+#define AOV_BUFFER_H
+
+#include "rtweekend.h"
+#include "framebuffer.h"
+
+// 辅助缓冲（AOV）
+// First-hit features of every pixel, averaged over a few jittered camera rays: the surface albedo,
+// the shading normal and the distance along the ray. They guide the denoiser and can be written
+// out for external ones. Depth is stored in all three channels; rays that miss leave a zero
+// normal and depth and an albedo of 1.
+struct aov_buffer
+{
+    framebuffer albedo;
+    framebuffer normal;
+    framebuffer depth;
+
+    void resize(int width, int height)
+    {
+        albedo.resize(width, height);
+        normal.resize(width, height);
+        depth.resize(width, height);
+    }
+
+    int width() const { return albedo.width(); }
+    int height() const { return albedo.height(); }
+};
+
+#endif
@@ -0,0 +1,112 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// 单调分配器
+// Hands out memory by bumping a pointer through large blocks and never frees individual
+// allocations; everything goes at once in release() or the destructor. Objects made with create()
+// have their destructors run then, newest first, so arena-allocated materials and textures may
+// still own ordinary resources (an image, a noise table).
+class arena
+{
+public:
+    explicit arena(size_t block_size = size_t(1) << 20) : block_size(block_size) {}
+    ~arena() { release(); }
+
+    arena(const arena &) = delete;
+    arena &operator=(const arena &) = delete;
+
+    void *allocate(size_t bytes, size_t alignment = alignof(std::max_align_t))
+    {
+        uintptr_t aligned = (uintptr_t(cursor) + alignment - 1) & ~uintptr_t(alignment - 1);
+        if (!cursor || aligned + bytes > uintptr_t(end))
+        {
+            // Oversized requests get a block of their own so the current one keeps its space.
+            size_t size = std::max(block_size, bytes + alignment);
+            char *data = static_cast<char *>(std::malloc(size));
+            if (!data)
+                throw std::bad_alloc();
+            blocks.push_back(data);
+            reserved += size;
+            cursor = data;
+            end = data + size;
+            aligned = (uintptr_t(cursor) + alignment - 1) & ~uintptr_t(alignment - 1);
+        }
+        cursor = reinterpret_cast<char *>(aligned + bytes);
+        used += bytes;
+        return reinterpret_cast<void *>(aligned);
+    }
+
+    // Uninitialised storage for n trivially destructible values.
+    template <typename T>
+    T *allocate_array(size_t n)
+    {
+        static_assert(std::is_trivially_destructible<T>::value, "arena arrays are never destroyed");
+        return n ? static_cast<T *>(allocate(n * sizeof(T), alignof(T))) : nullptr;
+    }
+
+    template <typename T, typename... Args>
+    T *create(Args &&...args)
+    {
+        T *object = new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+        if (!std::is_trivially_destructible<T>::value)
+        {
+            auto node = new (allocate(sizeof(destructor), alignof(destructor))) destructor;
+            node->destroy = [](void *p) { static_cast<T *>(p)->~T(); };
+            node->object = object;
+            node->next = destructors;
+            destructors = node;
+        }
+        return object;
+    }
+
+    void release()
+    {
+        for (destructor *node = destructors; node; node = node->next)
+            node->destroy(node->object);
+        destructors = nullptr;
+        for (auto block : blocks)
+            std::free(block);
+        blocks.clear();
+        cursor = end = nullptr;
+        used = reserved = 0;
+    }
+
+    size_t bytes_used() const { return used; }         // 已分配出去的字节数
+    size_t bytes_reserved() const { return reserved; } // 向系统申请的字节数
+
+private:
+    struct destructor
+    {
+        void (*destroy)(void *);
+        void *object;
+        destructor *next;
+    };
+
+    size_t block_size;
+    std::vector<char *> blocks;
+    char *cursor = nullptr;
+    char *end = nullptr;
+    destructor *destructors = nullptr;
+    size_t used = 0;
+    size_t reserved = 0;
+};
+
+// 不持有所有权的 shared_ptr：没有控制块，复制时不做引用计数。用于把 arena 中的对象传给
+// 接受 shared_ptr 的现有接口，对象的生命周期由 arena 决定。
+template <typename T>
+std::shared_ptr<T> unowned(T *object)
+{
+    return std::shared_ptr<T>(std::shared_ptr<T>(), object);
+}
+
+#endif
@@ -5,81 +5,94 @@
 #include "aabb.h"
 #include "hittable.h"
 #include "hittable_list.h"
-#include <algorithm>
-#include <random>
+#include "bvh_builder.h"
+#include "linear_bvh.h"
 
+#include <vector>
+
+// 扁平化的 BVH
+// Built with bvh_builder and stored as a linear_bvh: 32-byte nodes with index-based children, and
+// the primitives in one contiguous array in leaf order. Traversal is iterative and ordered.
 class BVHNode : public hittable
 {
 public:
-    BVHNode(hittable_list list) : BVHNode(list.objects, 0, list.objects.size()) {}
-    BVHNode(std::vector<shared_ptr<hittable>> &objects, size_t start, size_t end)
+    BVHNode(hittable_list list, const bvh_build_options &options = bvh_build_options())
     {
-        bbox = aabb::empty;
+        std::vector<aabb> boxes;
+        boxes.reserve(list.objects.size());
+        for (const auto &object : list.objects)
+            boxes.push_back(object->bounding_box());
+
+        bvh_builder builder(boxes, options);
+        auto root = builder.build();
+        nodes = linear_bvh(*root, builder.node_count());
 
-        for (size_t object_index = start; object_index < end; object_index++)
+        objects.reserve(list.objects.size());
+        primitives.reserve(list.objects.size());
+        for (auto index : builder.ordered_indices())
         {
-            bbox = aabb(bbox, objects[object_index]->bounding_box());
+            objects.push_back(list.objects[index]);
+            primitives.push_back(list.objects[index].get());
         }
 
-        int axis = bbox.longest_axis();
+        bbox = root->bbox;
+    }
 
-        auto comparator = (axis == 0)   ? box_x_compare
-                          : (axis == 1) ? box_y_compare
-                                        : box_z_compare;
+    bool hit(const ray &r, interval ray_t, hit_record &rec) const override
+    {
+        return hit_subtree(r, ray_t, rec, 0);
+    }
 
-        size_t object_span = end - start;
-        if (object_span == 1)
-            left = right = objects[start];
-        else if (object_span == 2)
+    // 光线包遍历：同一节点的数据由所有通道共享，通道发散后转为逐条光线遍历子树
+    void hit_packet(ray_packet &packet, unsigned lanes, packet_hit &hits) const override
+    {
+        nodes.traverse_packet(packet, lanes, packet_min_lanes, [&](uint32_t first, uint32_t count, unsigned active)
         {
-            left = objects[start];
-            right = objects[start + 1];
-        }
-        else
+            for (uint32_t i = first; i < first + count; i++)
+                primitives[i]->hit_packet(packet, active, hits);
+        },
+        [&](int k, uint32_t node)
         {
-            std::sort(objects.begin() + start, objects.begin() + end, comparator);
-            auto mid = start + object_span / 2;
-            left = make_shared<BVHNode>(objects, start, mid);
-            right = make_shared<BVHNode>(objects, mid, end);
-        }
+            if (hit_subtree(packet.rays[k], interval(packet.t_min, packet.t_max[k]), hits.rec[k], node))
+            {
+                packet.t_max[k] = hits.rec[k].t;
+                hits.mask |= 1u << k;
+            }
+        });
     }
-    bool hit(const ray &r, interval ray_t, hit_record &rec) const override
-    {
-        if (!bbox.hit(r, ray_t))
-            return false;
-        bool hit_left = left->hit(r, ray_t, rec);
-        bool hit_right = right->hit(r, ray_t, rec);
 
-        return hit_left || hit_right;
+    void collect_emitters(std::vector<const hittable *> &emitters) const override
+    {
+        for (auto primitive : primitives)
+            primitive->collect_emitters(emitters);
     }
 
     aabb bounding_box() const override { return bbox; }
 
+    // 光线包中仍在同一子树内的光线少于该数目时，改为逐条遍历
+    static const int packet_min_lanes = 3;
+
 private:
-    shared_ptr<hittable> left;
-    shared_ptr<hittable> right;
+    linear_bvh nodes;
+    std::vector<const hittable *> primitives;  // traversal order, non-owning
+    std::vector<shared_ptr<hittable>> objects; // keeps the primitives alive
     aabb bbox;
 
-    static bool box_compare(const shared_ptr<hittable> &a, const shared_ptr<hittable> &b, int axis_index)
-    {
-        auto a_axis_interval = a->bounding_box().axis_interval(axis_index);
-        auto b_axis_interval = b->bounding_box().axis_interval(axis_index);
-        return a_axis_interval.min < b_axis_interval.min;
-    }
-
-    static bool box_x_compare(const shared_ptr<hittable> a, const shared_ptr<hittable> b)
+    bool hit_subtree(const ray &r, interval ray_t, hit_record &rec, uint32_t start) const
     {
-        return box_compare(a, b, 0);
-    }
-
-    static bool box_y_compare(const shared_ptr<hittable> a, const shared_ptr<hittable> b)
-    {
-        return box_compare(a, b, 1);
-    }
-
-    static bool box_z_compare(const shared_ptr<hittable> a, const shared_ptr<hittable> b)
-    {
-        return box_compare(a, b, 2);
+        return nodes.traverse(r, ray_t, [&](uint32_t first, uint32_t count, interval &leaf_t)
+        {
+            bool hit_anything = false;
+            for (uint32_t i = first; i < first + count; i++)
+            {
+                if (primitives[i]->hit(r, leaf_t, rec))
+                {
+                    hit_anything = true;
+                    leaf_t.max = rec.t;
+                }
+            }
+            return hit_anything;
+        }, start);
     }
 };
 
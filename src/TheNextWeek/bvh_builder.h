@@ -0,0 +1,259 @@
+#ifndef BVH_BUILDER_H
+#define BVH_BUILDER_H
+
+#include "rtweekend.h"
+#include "aabb.h"
+
+#include <algorithm>
+#include <atomic>
+#include <future>
+#include <limits>
+#include <thread>
+#include <vector>
+
+// Conservative double -> float conversions for storing node bounds in single precision.
+inline float round_down_to_float(double v)
+{
+    float f = float(v);
+    return double(f) > v ? std::nextafter(f, -std::numeric_limits<float>::infinity()) : f;
+}
+
+inline float round_up_to_float(double v)
+{
+    float f = float(v);
+    return double(f) < v ? std::nextafter(f, std::numeric_limits<float>::infinity()) : f;
+}
+
+// BVH 构建参数
+struct bvh_build_options
+{
+    int max_leaf_size = 4;          // 叶节点最多包含的图元数
+    int bin_count = 16;             // 每个轴上的 SAH 分桶数
+    double traversal_cost = 1.0;    // 遍历一个内部节点的相对代价
+    double intersection_cost = 1.0; // 测试一个图元的相对代价
+    size_t parallel_threshold = 4096; // 子树图元数不少于该值时在新任务中构建
+};
+
+// Intermediate tree produced by the builder. Interior nodes own both children; leaves reference
+// the range [first, first + count) of bvh_builder::ordered_indices().
+struct bvh_build_node
+{
+    aabb bbox;
+    std::unique_ptr<bvh_build_node> left, right;
+    size_t first = 0;
+    size_t count = 0;
+    int axis = 0; // split axis of an interior node
+
+    bool is_leaf() const { return !left; }
+};
+
+// Binned surface-area-heuristic builder (Wald, "On fast Construction of SAH-based Bounding Volume
+// Hierarchies", 2007). It only sees primitive bounding boxes, so any primitive container can use
+// it; the caller reorders its primitives by ordered_indices() afterwards.
+class bvh_builder
+{
+public:
+    bvh_builder(const std::vector<aabb> &boxes, const bvh_build_options &options = bvh_build_options())
+        : options(options), node_total(0)
+    {
+        refs.reserve(boxes.size());
+        for (size_t i = 0; i < boxes.size(); i++)
+            refs.push_back(build_ref{boxes[i], boxes[i].centroid(), i});
+
+        if (this->options.bin_count < 2)
+            this->options.bin_count = 2;
+        if (this->options.max_leaf_size < 1)
+            this->options.max_leaf_size = 1;
+        if (this->options.max_leaf_size > max_leaf_limit)
+            this->options.max_leaf_size = max_leaf_limit;
+
+        // Spawn tasks only near the top of the tree, enough to keep every core busy.
+        unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+        max_task_depth = 2;
+        while ((1u << max_task_depth) < cores)
+            max_task_depth++;
+    }
+
+    std::unique_ptr<bvh_build_node> build()
+    {
+        auto root = build_range(0, refs.size(), 0);
+        ordered.resize(refs.size());
+        for (size_t i = 0; i < refs.size(); i++)
+            ordered[i] = refs[i].index;
+        return root;
+    }
+
+    // Primitive indices in leaf order; valid after build().
+    const std::vector<size_t> &ordered_indices() const { return ordered; }
+    size_t node_count() const { return node_total; }
+
+private:
+    static const int max_leaf_limit = 65535; // leaf counts are stored in 16 bits
+    static const unsigned sah_max_depth = 48; // below this depth only balanced median splits are made
+
+    struct build_ref
+    {
+        aabb bbox;
+        point3 centroid;
+        size_t index;
+    };
+
+    struct bin
+    {
+        aabb bbox = aabb::empty;
+        size_t count = 0;
+    };
+
+    bvh_build_options options;
+    std::vector<build_ref> refs;
+    std::vector<size_t> ordered;
+    std::atomic<size_t> node_total;
+    unsigned max_task_depth;
+
+    std::unique_ptr<bvh_build_node> build_range(size_t start, size_t end, unsigned depth)
+    {
+        std::unique_ptr<bvh_build_node> node(new bvh_build_node());
+        node_total++;
+
+        // Centroid bounds are tracked as raw points: aabb pads thin boxes, which would hide the
+        // degenerate case where every centroid coincides.
+        point3 centroid_min(infinity, infinity, infinity);
+        point3 centroid_max(-infinity, -infinity, -infinity);
+        node->bbox = aabb::empty;
+        for (size_t i = start; i < end; i++)
+        {
+            node->bbox = aabb(node->bbox, refs[i].bbox);
+            for (int a = 0; a < 3; a++)
+            {
+                centroid_min[a] = std::fmin(centroid_min[a], refs[i].centroid[a]);
+                centroid_max[a] = std::fmax(centroid_max[a], refs[i].centroid[a]);
+            }
+        }
+
+        size_t count = end - start;
+        node->first = start;
+        node->count = count;
+        if (count <= 1)
+            return node;
+
+        int axis;
+        size_t mid;
+        if (!find_split(node->bbox, centroid_min, centroid_max, start, end, depth, axis, mid))
+            return node;
+
+        node->axis = axis;
+        node->count = 0;
+
+        if (count >= options.parallel_threshold && depth < max_task_depth)
+        {
+            auto left_task = std::async(std::launch::async, &bvh_builder::build_range, this, start, mid, depth + 1);
+            node->right = build_range(mid, end, depth + 1);
+            node->left = left_task.get();
+        }
+        else
+        {
+            node->left = build_range(start, mid, depth + 1);
+            node->right = build_range(mid, end, depth + 1);
+        }
+        return node;
+    }
+
+    // Chooses the cheapest binned split and partitions refs[start, end) around it. Returns false
+    // when the primitives should stay together in a leaf.
+    bool find_split(const aabb &bounds, const point3 &centroid_min, const point3 &centroid_max,
+                    size_t start, size_t end, unsigned depth, int &best_axis, size_t &mid)
+    {
+        size_t count = end - start;
+        int bins = options.bin_count;
+        double leaf_cost = options.intersection_cost * count;
+        double best_cost = infinity;
+        int best_bin = -1;
+        vec3 extent = centroid_max - centroid_min;
+        best_axis = extent[0] > extent[1] ? (extent[0] > extent[2] ? 0 : 2) : (extent[1] > extent[2] ? 1 : 2);
+
+        std::vector<bin> bin_data(bins);
+        std::vector<double> right_area(bins);
+        std::vector<size_t> right_count(bins);
+
+        // Past sah_max_depth the tree is kept balanced so traversal stacks stay bounded.
+        for (int axis = 0; axis < 3 && depth < sah_max_depth; axis++)
+        {
+            if (extent[axis] <= 0)
+                continue;
+
+            std::fill(bin_data.begin(), bin_data.end(), bin());
+            double scale = bins / extent[axis];
+            for (size_t i = start; i < end; i++)
+            {
+                int b = bin_index(refs[i].centroid[axis], centroid_min[axis], scale);
+                bin_data[b].count++;
+                bin_data[b].bbox = aabb(bin_data[b].bbox, refs[i].bbox);
+            }
+
+            // Sweep from the right to get the area and count of every suffix of bins...
+            aabb accum = aabb::empty;
+            size_t accum_count = 0;
+            for (int b = bins - 1; b > 0; b--)
+            {
+                accum = aabb(accum, bin_data[b].bbox);
+                accum_count += bin_data[b].count;
+                right_count[b] = accum_count;
+                right_area[b] = accum_count ? accum.surface_area() : 0.0;
+            }
+
+            // ...then from the left, evaluating the split between bins b-1 and b.
+            accum = aabb::empty;
+            accum_count = 0;
+            for (int b = 1; b < bins; b++)
+            {
+                accum = aabb(accum, bin_data[b - 1].bbox);
+                accum_count += bin_data[b - 1].count;
+                if (accum_count == 0 || right_count[b] == 0)
+                    continue;
+
+                double cost = accum_count * accum.surface_area() + right_count[b] * right_area[b];
+                if (cost < best_cost)
+                {
+                    best_cost = cost;
+                    best_axis = axis;
+                    best_bin = b;
+                }
+            }
+        }
+
+        double parent_area = bounds.surface_area();
+        double split_cost = options.traversal_cost +
+                            options.intersection_cost * best_cost / (parent_area > 0 ? parent_area : 1.0);
+
+        if (best_bin >= 0 && (split_cost < leaf_cost || count > size_t(options.max_leaf_size)))
+        {
+            double scale = bins / extent[best_axis];
+            auto split = std::partition(refs.begin() + start, refs.begin() + end, [&](const build_ref &r)
+            {
+                return bin_index(r.centroid[best_axis], centroid_min[best_axis], scale) < best_bin;
+            });
+            mid = size_t(split - refs.begin());
+            if (mid != start && mid != end)
+                return true;
+        }
+
+        if (count <= size_t(options.max_leaf_size))
+            return false;
+
+        // All centroids coincide (or binning could not separate them): fall back to a median split.
+        mid = start + count / 2;
+        std::nth_element(refs.begin() + start, refs.begin() + mid, refs.begin() + end, [&](const build_ref &a, const build_ref &b)
+        {
+            return a.centroid[best_axis] < b.centroid[best_axis];
+        });
+        return true;
+    }
+
+    int bin_index(double centroid, double extent_min, double scale) const
+    {
+        int b = int((centroid - extent_min) * scale);
+        return b < 0 ? 0 : (b >= options.bin_count ? options.bin_count - 1 : b);
+    }
+};
+
+#endif
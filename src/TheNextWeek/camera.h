@@ -4,54 +4,277 @@
 #include "rtweekend.h"
 #include "hittable.h"
 #include "material.h"
+#include "thread_pool.h"
+#include "framebuffer.h"
+#include "image_writer.h"
+#include "accumulation_buffer.h"
+#include "light_sampler.h"
+#include "light_bvh.h"
+#include "aov_buffer.h"
+#include "denoiser.h"
+#include "cost_buffer.h"
+#include "scene_cache.h"
 
-class camera
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// 当前线程追踪过的光线数：主光线、反弹光线和阴影光线各算一条
+inline uint64_t &thread_ray_count()
+{
+    static thread_local uint64_t count = 0;
+    return count;
+}
+
+// 相机和输出设置
+// Plain values only, so a scene can carry its default view and a render job can copy and
+// override it before handing it to a camera.
+struct camera_settings
 {
-public:
     // 图像
     double aspect_ratio = 16.0 / 9.0; // 图像宽高比
     int image_width = 400;            // 图像宽度
-    int samples_per_pixel = 5;
-    int max_depth = 20;                // 最大递归深度
+    int samples_per_pixel = 5;         // 每个像素的采样数，自适应采样时为上限
+    int max_depth = 20;                // 每条路径最多追踪的光线数
+    int rr_min_depth = 3;              // 从第几次反弹起启用俄罗斯轮盘赌，不小于 max_depth 时关闭
+    bool light_sampling = true;        // 在漫反射表面上直接采样光源（下一事件估计），与散射采样做多重重要性采样
+    bool use_light_bvh = true;         // 按光源 BVH 估计的贡献选择光源；为 false 时均匀选择
     color background;                  // 背景颜色
     double vfov = 90.0;                // 视场角
     point3 lookfrom = point3(0, 0, 0); // Point camera is looking from
     point3 lookat = point3(0, 0, -1);  // Point camera is looking at
     vec3 vup = vec3(0, 1, 0);          // Camera-relative "up" direction
+    std::string scene_name;            // 由 make_scene 填写，只用于检查点的键
+
+    int thread_count = 0;              // 渲染线程数，0 表示使用全部硬件线程
+    int tile_size = 32;                // 分块渲染时每个 tile 的边长（像素）
+    uint64_t seed = 0;                 // 随机种子，相同种子的渲染结果逐位一致
+    bool packet_tracing = packet_tracing_default; // 主光线按 8 条一组成包求交，结果与逐条求交一致
+    sampler_kind sampler_type = sampler_kind::sobol; // 采样序列：independent/stratified/halton/sobol
+
+    // 自适应采样：像素的误差估计（伽马编码后亮度的标准误差）低于阈值时停止采样
+    bool adaptive_sampling = false;
+    double adaptive_threshold = 0.02;  // 约为 5/255
+    int adaptive_min_samples = 16;     // 至少采样这么多次才开始判断收敛
+    int adaptive_batch = 8;            // 之后每采样这么多次判断一次
+
+    std::string output_path;           // 输出文件，按扩展名选择 .ppm/.png/.pfm；为空时以 P6 写到标准输出
+
+    // 渐进式渲染：每一遍给每个像素增加 pass_samples 个采样，直到 samples_per_pixel
+    int pass_samples = 0;              // 0 表示一遍采完
+    std::string preview_path;          // 每一遍结束后把当前结果写到这里，为空则不写
+    std::string checkpoint_path;       // 每一遍结束后保存检查点；启动时若存在且匹配则从中继续
+
+    // 去噪：采样完成后用首次击中的反照率、法线和深度引导 à-trous 滤波，低采样数也能得到干净的图像
+    bool denoise = false;
+    denoiser_options denoise_options;
+    int aov_samples = 4;               // 辅助缓冲每个像素的主光线数
+    std::string albedo_path;           // 非空时写出对应的辅助缓冲，建议用 .pfm
+    std::string normal_path;
+    std::string depth_path;
+
+    std::string stats_path;            // 以 RT_STATS 编译时渲染结束后把统计写成 JSON，为空则写到 std::clog
+
+    // 代价热力图：每个像素所有采样的耗时、访问的 BVH 节点数和求交的图元数，非空时写出。
+    // 节点数和图元数要以 RT_STATS 编译。需要热力图时主光线逐条追踪（图像不变，只是慢一些）
+    std::string heatmap_time_path;
+    std::string heatmap_nodes_path;
+    std::string heatmap_primitives_path;
+};
+
+class camera : public camera_settings
+{
+public:
+    camera() {}
+    explicit camera(const camera_settings &settings) : camera_settings(settings) {}
+
+    void render(const hittable &world) // 渲染图像并输出
+    {
+        framebuffer image;
+        render(world, image);
+        write_image(output_path, image);
+    }
 
-    void render(const hittable &world) // 渲染图像
+    void render(const hittable &world, framebuffer &image) // 渲染到帧缓冲
     {
         initialize(); // 初始化相机参数
 
-        std::cout << "P3\n"
-                  << image_width << ' ' << image_height << "\n255\n"; // 输出图像格式和像素数
+        lights.reset();
+        if (light_sampling)
+        {
+            std::vector<const hittable *> emitters;
+            world.collect_emitters(emitters);
+            if (!emitters.empty() && use_light_bvh)
+                lights.reset(new light_bvh(emitters));
+            else if (!emitters.empty())
+                lights.reset(new uniform_light_sampler(emitters));
+            std::clog << "Sampling " << emitters.size() << " emitters directly\n";
+        }
+
+        sequence = make_sampler(sampler_type, samples_per_pixel);
+
+        costs.reset();
+        if (!heatmap_time_path.empty() || !heatmap_nodes_path.empty() || !heatmap_primitives_path.empty())
+        {
+            costs.reset(new cost_buffer());
+            costs->resize(image_width, image_height);
+#if !RT_STATS
+            if (!heatmap_nodes_path.empty() || !heatmap_primitives_path.empty())
+                std::cerr << "WARNING: Node and primitive heatmaps need a build with RT_STATS; they will be empty.\n";
+#endif
+        }
+
+        accumulation_buffer accum(image_width, image_height, seed, uint32_t(sampler_type), checkpoint_key(world));
+        if (!checkpoint_path.empty() && accum.load(checkpoint_path))
+            std::clog << "Resuming from '" << checkpoint_path << "' at " << accum.samples_done << " samples per pixel\n";
+
+        int tiles_x = (image_width + tile_size - 1) / tile_size;
+        int tiles_y = (image_height + tile_size - 1) / tile_size;
+        int tile_count = tiles_x * tiles_y;
+
+        thread_pool pool(thread_count);
+        rays_traced = 0;
+        stats.clear();
+        std::clog << "Rendering " << tile_count << " tiles on " << pool.size() << " threads\n";
 
-        for (int j = 0; j < image_height; j++) // 垂直扫描线循环
+        int pass_size = pass_samples > 0 ? pass_samples : samples_per_pixel;
+        while (accum.samples_done < samples_per_pixel)
         {
-            std::clog << "\rScanlines remaining: " << (image_height - j) << ' ' << std::flush; // 显示剩余扫描线数
-            for (int i = 0; i < image_width; i++)                                              // 水平扫描线循环
+            int target = std::min(samples_per_pixel, accum.samples_done + pass_size);
+
+            std::mutex progress_lock;
+            int tiles_done = 0;
+
+            pool.parallel_for(tile_count, [&](int tile, int)
             {
-                color pixel_color(0, 0, 0);                                // 初始化像素颜色
-                for (int sample = 0; sample < samples_per_pixel; sample++) // 多次采样
-                {
-                    ray r = get_ray(i, j);
-                    pixel_color += ray_color(r, max_depth, world); // 计算像素颜色
-                }
-                write_color(std::cout, pixel_color * pixel_sample_scale);
+                int x0 = (tile % tiles_x) * tile_size;
+                int y0 = (tile / tiles_x) * tile_size;
+                uint64_t rays_before = thread_ray_count();
+                RT_STAT(thread_stats().clear());
+                render_tile(world, accum, x0, y0, std::min(x0 + tile_size, image_width),
+                            std::min(y0 + tile_size, image_height), accum.samples_done, target);
+
+                std::lock_guard<std::mutex> guard(progress_lock);
+                rays_traced += thread_ray_count() - rays_before;
+                RT_STAT(stats.merge(thread_stats()));
+                tiles_done++;
+                std::clog << "\rSamples " << accum.samples_done << '-' << target
+                          << ", tiles remaining: " << (tile_count - tiles_done) << ' ' << std::flush;
+            });
+            accum.samples_done = target;
+
+            if (!preview_path.empty())
+            {
+                accum.resolve(image);
+                write_image(preview_path, image);
+            }
+            if (!checkpoint_path.empty())
+                accum.save(checkpoint_path);
+        }
+
+        accum.resolve(image);
+        std::clog << "\rDone.                                        \n"; // 完成渲染
+        RT_STAT(write_stats());
+        write_heatmaps();
+        if (adaptive_sampling)
+            std::clog << "Average samples per pixel: " << double(accum.total_samples()) / image.pixel_count() << '\n';
+
+        if (denoise || !albedo_path.empty() || !normal_path.empty() || !depth_path.empty())
+        {
+            aov_buffer aovs;
+            render_aovs(world, aovs, pool);
+            if (!albedo_path.empty())
+                write_image(albedo_path, aovs.albedo);
+            if (!normal_path.empty())
+                write_image(normal_path, aovs.normal);
+            if (!depth_path.empty())
+                write_image(depth_path, aovs.depth);
+
+            if (denoise)
+            {
+                std::clog << "Denoising\n";
+                std::vector<float> variance(accum.pixels.size());
+                for (size_t p = 0; p < variance.size(); p++)
+                    variance[p] = float(accum.pixels[p].mean_variance());
+                denoiser(denoise_options).apply(image, aovs, variance, pool);
             }
         }
-        std::clog << "\rDone.                 \n"; // 完成渲染
     }
 
+    // 上一次 render() 的路径追踪共发出的光线数，不含辅助缓冲的光线
+    uint64_t ray_count() const { return rays_traced; }
+
+    // 上一次 render() 的统计，只在以 RT_STATS 编译时有内容
+    const render_stats &statistics() const { return stats; }
+
 private:
     // 相机
     int image_height;                // 渲染图像高度
-    double pixel_sample_scale = 1.0; // 像素采样比例
     point3 center;                   // 相机中心
     point3 pixel00_loc;              // 像素0,0的位置
     vec3 pixel_delta_u;              // 到右侧像素的偏移
     vec3 pixel_delta_v;              // 到下方像素的偏移
     vec3 u, v, w;                    // Camera frame basis vectors
+    std::unique_ptr<light_sampler> lights; // 本次渲染的光源采样器，没有可采样的光源时为空
+    std::unique_ptr<sampler> sequence;     // 本次渲染的采样器
+    uint64_t rays_traced = 0;
+    render_stats stats = render_stats();
+    std::unique_ptr<cost_buffer> costs;    // 本次渲染的代价热力图，不需要时为空
+
+    void write_heatmaps()
+    {
+        if (!costs)
+            return;
+        if (!heatmap_time_path.empty())
+            costs->write(heatmap_time_path, costs->ticks, cost_tick_unit);
+        if (!heatmap_nodes_path.empty())
+            costs->write(heatmap_nodes_path, costs->nodes, "BVH nodes visited");
+        if (!heatmap_primitives_path.empty())
+            costs->write(heatmap_primitives_path, costs->primitives, "primitives tested");
+        costs.reset();
+    }
+
+    void write_stats() const
+    {
+        if (stats_path.empty())
+        {
+            std::clog << "Render statistics:\n";
+            stats.write_json(std::clog);
+            return;
+        }
+        std::ofstream out(stats_path);
+        stats.write_json(out);
+        out.close();
+        if (!out)
+            std::cerr << "ERROR: Could not write render statistics '" << stats_path << "'.\n";
+    }
+
+    // 检查点的键：场景和所有影响图像的相机设置。尺寸、种子和采样器另外存在检查点里；
+    // 线程数、tile 大小、每遍采样数和光线包只改变采样的顺序，不在其中
+    uint64_t checkpoint_key(const hittable &world) const
+    {
+        content_hasher hasher;
+        hasher.add_value(uint32_t(sizeof(real)));
+        hasher.add_value(uint64_t(scene_name.size()));
+        hasher.add(scene_name.data(), scene_name.size());
+        aabb bounds = world.bounding_box();
+        const double box[6] = {bounds.x.min, bounds.x.max, bounds.y.min, bounds.y.max, bounds.z.min, bounds.z.max};
+        hasher.add(box, sizeof(box));
+
+        const double view[12] = {aspect_ratio, vfov, lookfrom.x(), lookfrom.y(), lookfrom.z(), lookat.x(), lookat.y(),
+                                 lookat.z(), vup.x(), vup.y(), vup.z(), adaptive_threshold};
+        hasher.add(view, sizeof(view));
+        const double sky[3] = {background.x(), background.y(), background.z()};
+        hasher.add(sky, sizeof(sky));
+        const int32_t path[8] = {samples_per_pixel, max_depth, rr_min_depth, light_sampling, use_light_bvh,
+                                 adaptive_sampling, adaptive_min_samples, adaptive_batch};
+        hasher.add(path, sizeof(path));
+        return hasher.value();
+    }
 
     void initialize() // 初始化相机参数
     {
@@ -80,8 +303,183 @@ private:
         // 计算左上角像素的位置
         auto viewport_upper_left = center - (focal_length * w) - viewport_u / 2 - viewport_v / 2;
         pixel00_loc = viewport_upper_left + 0.5 * (pixel_delta_u + pixel_delta_v);
+    }
+
+    // 为 [x0,x1) x [y0,y1) 范围内的像素采第 [first, last) 个样本，累加到 accum。
+    // 自适应采样时整个 tile 分批采样，每批之后像素在其 3x3 邻域（限于 tile 内）的误差都低于阈值
+    // 才停止，这样少数几次采样恰好全为零的像素不会被误判为已收敛。
+    void render_tile(const hittable &world, accumulation_buffer &accum, int x0, int y0, int x1, int y1,
+                     int first, int last) const
+    {
+        scoped_sampler use_sequence(sequence.get());
+        int tile_width = x1 - x0, tile_height = y1 - y0;
+        std::vector<double> errors(size_t(tile_width) * tile_height);
+
+        for (int sample = first; sample < last;)
+        {
+            int stop = std::min(next_check(sample), last);
+            if (packet_tracing && !costs)
+                sample_tile_packets(world, accum, x0, y0, x1, y1, sample, stop);
+            else
+                sample_tile(world, accum, x0, y0, x1, y1, sample, stop);
+            sample = stop;
+
+            // Convergence is only tested on the adaptive schedule, not where a pass happens to
+            // end, so splitting a render into passes does not change the result.
+            if (!adaptive_sampling || stop != next_check(stop - 1))
+                continue;
 
-        pixel_sample_scale = 1.0 / samples_per_pixel; // 计算像素采样比例
+            for (int y = 0; y < tile_height; y++)
+                for (int x = 0; x < tile_width; x++)
+                    errors[size_t(y) * tile_width + x] = accum.pixels[size_t(y0 + y) * image_width + x0 + x].display_error();
+
+            bool any_active = false;
+            for (int y = 0; y < tile_height; y++)
+            {
+                for (int x = 0; x < tile_width; x++)
+                {
+                    char &active = accum.active[size_t(y0 + y) * image_width + x0 + x];
+                    if (!active)
+                        continue;
+                    double error = 0;
+                    for (int ny = std::max(0, y - 1); ny <= std::min(tile_height - 1, y + 1); ny++)
+                        for (int nx = std::max(0, x - 1); nx <= std::min(tile_width - 1, x + 1); nx++)
+                            error = std::max(error, errors[size_t(ny) * tile_width + nx]);
+                    active = error >= adaptive_threshold;
+                    any_active = any_active || active;
+                }
+            }
+            if (!any_active)
+                break;
+        }
+    }
+
+    // 为 tile 中仍在采样的像素采第 [first, last) 个样本
+    void sample_tile(const hittable &world, accumulation_buffer &accum, int x0, int y0, int x1, int y1,
+                     int first, int last) const
+    {
+        for (int j = y0; j < y1; j++)
+        {
+            for (int i = x0; i < x1; i++)
+            {
+                uint64_t pixel = uint64_t(j) * image_width + i;
+                if (!accum.active[pixel])
+                    continue;
+
+                pixel_cost cost_start;
+                if (costs)
+                    cost_start = pixel_cost::now();
+
+                for (int sample = first; sample < last; sample++) // 多次采样
+                {
+                    seed_random(seed, pixel, sample, 0);
+                    ray r = get_ray(i, j);
+                    accum.pixels[pixel].add(ray_color(r, world, pixel, sample)); // 计算像素颜色
+                }
+
+                if (costs)
+                    costs->add(pixel, cost_start, pixel_cost::now());
+            }
+        }
+    }
+
+    // 光线包版本：同一行中相邻的最多 8 个像素的同一采样组成一个包，
+    // 主光线一起求交，之后的反弹仍逐条追踪。已收敛的像素不进入包。
+    void sample_tile_packets(const hittable &world, accumulation_buffer &accum, int x0, int y0, int x1, int y1,
+                             int first, int last) const
+    {
+        ray_packet packet;
+        packet_hit hits;
+
+        for (int j = y0; j < y1; j++)
+        {
+            for (int i0 = x0; i0 < x1; i0 += ray_packet::max_size)
+            {
+                uint64_t pixel0 = uint64_t(j) * image_width + i0;
+                packet.size = std::min(ray_packet::max_size, x1 - i0);
+                unsigned lanes = 0;
+                for (int k = 0; k < packet.size; k++)
+                    lanes |= unsigned(accum.active[pixel0 + k] != 0) << k;
+                if (!lanes)
+                    continue;
+
+                for (int sample = first; sample < last; sample++)
+                {
+                    for (unsigned m = lanes; m; m &= m - 1)
+                    {
+                        int k = lowest_lane(m);
+                        seed_random(seed, pixel0 + k, sample, 0);
+                        packet.set(k, get_ray(i0 + k, j), interval(0, infinity));
+                    }
+
+                    hits.mask = 0;
+                    if (max_depth > 0)
+                    {
+                        for (unsigned m = lanes; m; m &= m - 1)
+                            thread_ray_count()++;
+                        RT_STAT(thread_stats().rays_by_depth[0] += lane_count(lanes));
+                        world.hit_packet(packet, lanes, hits);
+                    }
+
+                    for (unsigned m = lanes; m; m &= m - 1)
+                    {
+                        int k = lowest_lane(m);
+                        bool hit = (hits.mask >> k) & 1u;
+                        accum.pixels[pixel0 + k].add(trace_path(packet.rays[k], hit, hits.rec[k], world, pixel0 + k, sample));
+                    }
+                }
+            }
+        }
+    }
+
+    // 采完第 sample 个样本之后的下一个收敛检查点：adaptive_min_samples，之后每隔 adaptive_batch 个；
+    // 非自适应时一次采满
+    int next_check(int sample) const
+    {
+        if (!adaptive_sampling)
+            return samples_per_pixel;
+        int batch = std::max(1, adaptive_batch);
+        int stop = sample < adaptive_min_samples
+                       ? adaptive_min_samples
+                       : adaptive_min_samples + ((sample - adaptive_min_samples) / batch + 1) * batch;
+        return std::min(stop, samples_per_pixel);
+    }
+
+    // 辅助缓冲：每个像素发 aov_samples 条主光线（与前几个路径样本的抖动相同），记录首次击中的信息
+    void render_aovs(const hittable &world, aov_buffer &aovs, thread_pool &pool) const
+    {
+        aovs.resize(image_width, image_height);
+        int samples = std::max(1, aov_samples);
+        double scale = 1.0 / samples;
+
+        pool.parallel_for(image_height, [&](int j, int)
+        {
+            scoped_sampler use_sequence(sequence.get());
+            for (int i = 0; i < image_width; i++)
+            {
+                uint64_t pixel = uint64_t(j) * image_width + i;
+                color albedo(0, 0, 0);
+                vec3 normal(0, 0, 0);
+                double depth = 0;
+                for (int sample = 0; sample < samples; sample++)
+                {
+                    seed_random(seed, pixel, sample, 0);
+                    ray r = get_ray(i, j);
+                    hit_record rec;
+                    if (world.hit(r, interval(0, infinity), rec))
+                    {
+                        albedo += rec.mat_ptr->surface_albedo(rec);
+                        normal += rec.normal;
+                        depth += rec.t * r.direction().length();
+                    }
+                    else
+                        albedo += color(1, 1, 1);
+                }
+                aovs.albedo.set(i, j, albedo * scale);
+                aovs.normal.set(i, j, normal * scale);
+                aovs.depth.set(i, j, color(depth, depth, depth) * scale);
+            }
+        });
     }
 
     // 获取从摄像机位置发出的光线
@@ -109,28 +507,136 @@ private:
         return vec3(random_double() - 0.5, random_double() - 0.5, 0);
     }
 
-    color ray_color(const ray &r, int depth, const hittable &world) const
+    color ray_color(const ray &r, const hittable &world, uint64_t pixel, int sample) const
     {
         // If we've exceeded the ray bounce limit, no more light is gathered.
-        if (depth <= 0)
+        if (max_depth <= 0)
             return color(0, 0, 0);
 
         hit_record rec;
+        thread_ray_count()++;
+        RT_STAT(thread_stats().ray(0));
+        bool hit = world.hit(r, interval(0, infinity), rec);
+        return trace_path(r, hit, rec, world, pixel, sample);
+    }
+
+    // 迭代的路径追踪：r 是路径的第一条光线，hit/rec 是它的求交结果。
+    // throughput 记录路径到当前顶点为止的衰减；rr_min_depth 次反弹之后按 throughput 的最大分量
+    // 做俄罗斯轮盘赌，幸存的路径除以存活概率以保持估计无偏。
+    //
+    // 有光源采样器时，每个非镜面顶点再向一个光源发一条阴影光线（下一事件估计）。光源采样和散射
+    // 采样都能得到同一条光路，两者用幂启发式（power heuristic）加权合并（Veach 1997）。
+    color trace_path(ray r, bool hit, hit_record &rec, const hittable &world, uint64_t pixel, int sample) const
+    {
+        color radiance(0, 0, 0);
+        color throughput(1, 1, 1);
+
+        // 上一个顶点的信息，用于给散射光线击中的光源加权
+        bool prev_specular = true; // 相机光线和镜面散射的光线只能靠击中光源得到光照
+        double prev_pdf = 0;
+        point3 prev_p;
+        vec3 prev_n;
+
+        int bounce = 0;
+        for (; bounce < max_depth; bounce++)
+        {
+            // If the ray hits nothing, return the background color.
+            if (!hit)
+            {
+                radiance += throughput * background;
+                break;
+            }
+
+            // 每次反弹按 (pixel, sample, bounce) 重新播种，与线程调度无关
+            seed_random(seed, pixel, sample, bounce + 1);
+            RT_STAT(thread_stats().material_hit(rec.mat_ptr->type_name()));
+
+            color emission = rec.mat_ptr->emitted(rec.u, rec.v, rec.p);
+            if (rec.mat_ptr->is_emissive())
+            {
+                double weight = 1;
+                if (!prev_specular && lights)
+                {
+                    double light_pdf = lights->pmf(prev_p, prev_n, rec.object) * rec.object->pdf_value(prev_p, r.direction());
+                    weight = power_heuristic(prev_pdf, light_pdf);
+                }
+                emission = emission * weight;
+            }
+            radiance += throughput * emission;
+
+            ray scattered;
+            color attenuation;
+            if (bounce + 1 == max_depth || !rec.mat_ptr->scatter(r, rec, attenuation, scattered))
+                break;
+            RT_STAT(thread_stats().scatters++);
+            // 材质从 rec.p 发出散射光线；把起点移出表面，之后从 t = 0 开始求交
+            scattered = rec.spawn_ray(scattered.direction(), scattered.get_time());
 
-        // If the ray hits nothing, return the background color.
-        if (!world.hit(r, interval(0.001, infinity), rec))
-            return background;
+            prev_specular = rec.mat_ptr->is_specular();
+            if (!prev_specular)
+            {
+                prev_pdf = rec.mat_ptr->scattering_pdf(r, rec, scattered);
+                prev_p = rec.p;
+                prev_n = rec.normal;
+                if (lights)
+                    radiance += throughput * sample_light(r, rec, attenuation, world);
+            }
 
-        ray scattered;
-        color attenuation;
-        color color_from_emission = rec.mat_ptr->emitted(rec.u, rec.v, rec.p);
+            throughput = throughput * attenuation;
 
-        if (!rec.mat_ptr->scatter(r, rec, attenuation, scattered))
-            return color_from_emission;
+            if (bounce + 1 >= rr_min_depth)
+            {
+                start_dimension(dimension_roulette);
+                double survive = std::min(0.95, double(std::max(throughput.x(), std::max(throughput.y(), throughput.z()))));
+                if (random_double() >= survive)
+                    break;
+                throughput /= survive;
+            }
 
-        color color_from_scatter = attenuation * ray_color(scattered, depth - 1, world);
+            r = scattered;
+            thread_ray_count()++;
+            RT_STAT(thread_stats().ray(bounce + 1));
+            hit = world.hit(r, interval(0, infinity), rec);
+        }
 
-        return color_from_emission + color_from_scatter;
+        // 路径共追踪了 bounce + 1 段光线（循环正常结束时为 max_depth 段）
+        RT_STAT(thread_stats().path(std::min(bounce + 1, max_depth)));
+        return radiance;
+    }
+
+    // 下一事件估计：选一个光源、在其上采样一个方向，用阴影光线检查可见性，
+    // 返回按光源采样概率和 MIS 权重换算后的直接光照（尚未乘 throughput）
+    color sample_light(const ray &r_in, const hit_record &rec, const color &attenuation, const hittable &world) const
+    {
+        double pick_pdf;
+        start_dimension(dimension_light_pick);
+        const hittable *light = lights->sample(rec.p, rec.normal, random_double(), pick_pdf);
+        if (!light || pick_pdf <= 0)
+            return color(0, 0, 0);
+
+        start_dimension(dimension_light);
+        ray to_light = rec.spawn_ray(light->random(rec.p), r_in.get_time());
+        double light_pdf = pick_pdf * light->pdf_value(rec.p, to_light.direction());
+        double bsdf_pdf = rec.mat_ptr->scattering_pdf(r_in, rec, to_light);
+        if (light_pdf <= 0 || bsdf_pdf <= 0)
+            return color(0, 0, 0);
+
+        // 阴影光线：最近的交点必须就在所选光源上
+        hit_record light_rec;
+        thread_ray_count()++;
+        RT_STAT(thread_stats().shadow_rays++);
+        if (!world.hit(to_light, interval(0, infinity), light_rec) || light_rec.object != light)
+            return color(0, 0, 0);
+
+        color emission = light_rec.mat_ptr->emitted(light_rec.u, light_rec.v, light_rec.p);
+        color brdf_cos = attenuation * bsdf_pdf;
+        return brdf_cos * emission * (power_heuristic(light_pdf, bsdf_pdf) / light_pdf);
+    }
+
+    static double power_heuristic(double pdf_a, double pdf_b)
+    {
+        double a2 = pdf_a * pdf_a, b2 = pdf_b * pdf_b;
+        return a2 + b2 > 0 ? a2 / (a2 + b2) : 0;
     }
 };
 
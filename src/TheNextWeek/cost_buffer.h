@@ -0,0 +1,131 @@
+#ifndef COST_BUFFER_H
+#define COST_BUFFER_H
+
+#include "rtweekend.h"
+#include "framebuffer.h"
+#include "image_writer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define COST_BUFFER_RDTSC
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define COST_BUFFER_RDTSC
+#endif
+
+#if defined(COST_BUFFER_RDTSC)
+const char *const cost_tick_unit = "cycles";
+#else
+const char *const cost_tick_unit = "nanoseconds";
+#endif
+
+// 一个像素的代价：耗时和（以 RT_STATS 编译时）访问的 BVH 节点数、求交的图元数
+struct pixel_cost
+{
+    uint64_t ticks = 0;
+    uint64_t nodes = 0;
+    uint64_t primitives = 0;
+
+    // 当前线程的计数器读数；两次读数之差就是其间的代价。
+    // ticks are TSC cycles on x86 and steady-clock nanoseconds elsewhere.
+    static pixel_cost now()
+    {
+        pixel_cost c;
+#if defined(COST_BUFFER_RDTSC)
+        c.ticks = __rdtsc();
+#else
+        c.ticks = uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                               std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+#if RT_STATS
+        c.nodes = thread_stats().node_visits;
+        c.primitives = thread_stats().primitive_tests;
+#endif
+        return c;
+    }
+};
+
+// 代价热力图
+// Per-pixel totals over all of a pixel's samples in this render, so adaptive sampling's extra
+// samples show up as cost. Written as raw values to .pfm, or elsewhere as a false-colour image
+// (black through purple and orange to pale yellow) scaled to the 99th percentile, so a handful
+// of extreme pixels do not flatten the rest of the map.
+struct cost_buffer
+{
+    std::vector<double> ticks;
+    std::vector<double> nodes;
+    std::vector<double> primitives;
+    int image_width = 0, image_height = 0;
+
+    void resize(int width, int height)
+    {
+        image_width = width;
+        image_height = height;
+        size_t count = size_t(width) * height;
+        ticks.assign(count, 0.0);
+        nodes.assign(count, 0.0);
+        primitives.assign(count, 0.0);
+    }
+
+    void add(uint64_t pixel, const pixel_cost &start, const pixel_cost &end)
+    {
+        ticks[pixel] += double(end.ticks - start.ticks);
+        nodes[pixel] += double(end.nodes - start.nodes);
+        primitives[pixel] += double(end.primitives - start.primitives);
+    }
+
+    // what 用于日志，如 "cycles"
+    bool write(const std::string &path, const std::vector<double> &values, const char *what) const
+    {
+        framebuffer image(image_width, image_height);
+        double scale = percentile(values, 0.99);
+        std::clog << "Heatmap '" << path << "': " << what << " per pixel, max " << *std::max_element(values.begin(), values.end())
+                  << ", 99th percentile " << scale << '\n';
+
+        bool raw = image_format_from_path(path) == image_format::pfm;
+        for (int y = 0; y < image_height; y++)
+        {
+            for (int x = 0; x < image_width; x++)
+            {
+                double v = values[size_t(y) * image_width + x];
+                image.set(x, y, raw ? color(v, v, v) : heat_color(scale > 0 ? v / scale : 0));
+            }
+        }
+        return write_image(path, image);
+    }
+
+private:
+    static double percentile(std::vector<double> values, double fraction)
+    {
+        if (values.empty())
+            return 0;
+        size_t k = std::min(values.size() - 1, size_t(fraction * values.size()));
+        std::nth_element(values.begin(), values.begin() + k, values.end());
+        return values[k];
+    }
+
+    // t in [0,1] 映射到颜色。image_writer 会做 gamma 2 编码，所以返回显示颜色的平方
+    static color heat_color(double t)
+    {
+        static const double stops[5][3] = {
+            {0.00, 0.00, 0.02}, {0.34, 0.06, 0.43}, {0.74, 0.22, 0.33}, {0.98, 0.56, 0.04}, {0.99, 1.00, 0.64}};
+        t = std::min(1.0, std::max(0.0, t)) * 4;
+        int i = std::min(3, int(t));
+        double f = t - i;
+        double c[3];
+        for (int k = 0; k < 3; k++)
+        {
+            c[k] = stops[i][k] + f * (stops[i + 1][k] - stops[i][k]);
+            c[k] *= c[k];
+        }
+        return color(c[0], c[1], c[2]);
+    }
+};
+
+#endif
@@ -0,0 +1,227 @@
+#ifndef DENOISER_H
+#define DENOISER_H
+
+#include "rtweekend.h"
+#include "framebuffer.h"
+#include "aov_buffer.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+struct denoiser_options
+{
+    int iterations = 5;            // 滤波次数，第 i 次的采样间隔为 2^i 像素
+    double sigma_luminance = 4;    // 亮度差按像素的标准误差归一化后的容差
+    int normal_power = 128;        // 法线权重 max(0, n_p . n_q)^normal_power，取 2 的幂时最快
+    double sigma_depth = 1;        // 深度差按局部深度梯度归一化后的容差
+};
+
+// 边缘保持的 à-trous 小波去噪
+// Repeatedly applies a 5x5 B3-spline kernel with holes of 2^i pixels (Dammertz et al., "Edge-
+// Avoiding À-Trous Wavelet Transform for fast Global Illumination Filtering", 2010), so five
+// passes cover a 125 pixel footprint at 25 taps each. Every tap is weighted by how closely its
+// normal and depth match the centre pixel and by its luminance difference relative to the centre's
+// standard error, with the error propagated through the passes as in SVGF (Schied et al. 2017):
+// converged pixels are left alone and noisy ones are smoothed.
+//
+// The filter runs on illumination: the colour is divided by the first-hit albedo beforehand and
+// multiplied back afterwards, so textures stay sharp. Rows are filtered in parallel.
+class denoiser
+{
+public:
+    denoiser() {}
+    explicit denoiser(const denoiser_options &options) : options(options) {}
+
+    // variance holds each pixel's variance of the mean luminance; infinity where unknown.
+    void apply(framebuffer &image, const aov_buffer &aovs, const std::vector<float> &variance, thread_pool &pool) const
+    {
+        guide g;
+        g.width = image.width();
+        g.height = image.height();
+        size_t count = image.pixel_count();
+        if (count == 0)
+            return;
+
+        // 解调：颜色除以反照率
+        std::vector<float> demodulate(count * 3);
+        std::vector<float> illumination(count * 3), next_illumination(count * 3);
+        std::vector<float> var(count), next_var(count);
+        const float *rgb = image.data();
+        const float *albedo = aovs.albedo.data();
+        for (size_t p = 0; p < count; p++)
+        {
+            for (int c = 0; c < 3; c++)
+            {
+                float a = albedo[p * 3 + c];
+                demodulate[p * 3 + c] = a > 0.01f ? a : 1.0f;
+                illumination[p * 3 + c] = rgb[p * 3 + c] / demodulate[p * 3 + c];
+            }
+            float y = luminance_of(&demodulate[p * 3]);
+            var[p] = clamp_variance(variance[p] / (y * y));
+        }
+
+        // 平均后的法线在边缘处变短，重新归一化；未击中的像素保持为 0
+        g.normals.resize(count * 3);
+        g.depths.resize(count);
+        for (size_t p = 0; p < count; p++)
+        {
+            const float *n = &aovs.normal.data()[p * 3];
+            float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            float scale = length > 0 ? 1 / length : 0.0f;
+            for (int c = 0; c < 3; c++)
+                g.normals[p * 3 + c] = n[c] * scale;
+            g.depths[p] = aovs.depth.data()[p * 3];
+        }
+        depth_gradient(g);
+
+        int rows_per_item = 8;
+        int items = (g.height + rows_per_item - 1) / rows_per_item;
+        for (int iteration = 0; iteration < options.iterations; iteration++)
+        {
+            int step = 1 << iteration;
+            pool.parallel_for(items, [&](int item, int)
+            {
+                int y1 = std::min(g.height, (item + 1) * rows_per_item);
+                for (int y = item * rows_per_item; y < y1; y++)
+                    filter_row(g, y, step, illumination, var, next_illumination, next_var);
+            });
+            illumination.swap(next_illumination);
+            var.swap(next_var);
+        }
+
+        float *out = image.data();
+        for (size_t k = 0; k < count * 3; k++)
+            out[k] = illumination[k] * demodulate[k];
+    }
+
+private:
+    // 引导滤波的几何信息
+    struct guide
+    {
+        int width = 0, height = 0;
+        std::vector<float> normals; // 交错的单位法线，未击中的像素为 0
+        std::vector<float> depths;
+        std::vector<float> gradients;
+    };
+
+    // 未知方差（采样数不足 2）按一个很大的有限值处理，避免 0 * inf
+    static float clamp_variance(float v) { return v < 1e30f ? v : 1e30f; }
+
+    denoiser_options options;
+
+    static float luminance_of(const float *c) { return 0.2126f * c[0] + 0.7152f * c[1] + 0.0722f * c[2]; }
+
+    // 每个像素的深度梯度：两个方向上各取较小的单侧差分，避免把物体边缘算成陡坡
+    static void depth_gradient(guide &g)
+    {
+        const float none = std::numeric_limits<float>::infinity();
+        const int w = g.width;
+        g.gradients.assign(g.depths.size(), 0.0f);
+        for (int y = 0; y < g.height; y++)
+        {
+            for (int x = 0; x < w; x++)
+            {
+                const float *z = &g.depths[size_t(y) * w + x];
+                float gx = std::min(x > 0 ? std::fabs(z[0] - z[-1]) : none, x + 1 < w ? std::fabs(z[0] - z[1]) : none);
+                float gy = std::min(y > 0 ? std::fabs(z[0] - z[-w]) : none, y + 1 < g.height ? std::fabs(z[0] - z[w]) : none);
+                gx = gx < none ? gx : 0.0f;
+                gy = gy < none ? gy : 0.0f;
+                g.gradients[size_t(y) * w + x] = std::max(gx, gy);
+            }
+        }
+    }
+
+    float normal_weight(float cos_angle) const
+    {
+        float w = std::max(cos_angle, 0.0f);
+        float result = 1;
+        for (int e = options.normal_power; e > 0; e >>= 1, w *= w)
+            if (e & 1)
+                result *= w;
+        return result;
+    }
+
+    // 3x3 高斯模糊后的方差，使亮度权重不被单个像素的方差估计左右
+    static float blurred_variance(const guide &g, int x, int y, const std::vector<float> &var)
+    {
+        static const float kernel[2] = {0.25f, 0.125f};
+        float sum = 0, weight = 0;
+        for (int dy = -1; dy <= 1; dy++)
+        {
+            for (int dx = -1; dx <= 1; dx++)
+            {
+                int qx = x + dx, qy = y + dy;
+                if (qx < 0 || qx >= g.width || qy < 0 || qy >= g.height)
+                    continue;
+                float k = kernel[dx != 0] * kernel[dy != 0];
+                sum += k * var[size_t(qy) * g.width + qx];
+                weight += k;
+            }
+        }
+        return sum / weight;
+    }
+
+    void filter_row(const guide &g, int y, int step, const std::vector<float> &in, const std::vector<float> &in_var,
+                    std::vector<float> &out, std::vector<float> &out_var) const
+    {
+        static const float kernel[3] = {3.0f / 8, 1.0f / 4, 1.0f / 16};
+        const float sigma_luminance = float(options.sigma_luminance);
+        const float sigma_depth = float(options.sigma_depth);
+
+        for (int x = 0; x < g.width; x++)
+        {
+            size_t p = size_t(y) * g.width + x;
+            const float *np = &g.normals[p * 3];
+            bool p_hit = np[0] != 0 || np[1] != 0 || np[2] != 0;
+            float zp = g.depths[p];
+            float lp = luminance_of(&in[p * 3]);
+            float luminance_scale = sigma_luminance * std::sqrt(blurred_variance(g, x, y, in_var)) + 1e-6f;
+            float depth_scale = sigma_depth * g.gradients[p] * step;
+
+            float sum[3] = {0, 0, 0};
+            float weight_sum = 0, var_sum = 0;
+            for (int dy = -2; dy <= 2; dy++)
+            {
+                int qy = y + dy * step;
+                if (qy < 0 || qy >= g.height)
+                    continue;
+                for (int dx = -2; dx <= 2; dx++)
+                {
+                    int qx = x + dx * step;
+                    if (qx < 0 || qx >= g.width)
+                        continue;
+                    size_t q = size_t(qy) * g.width + qx;
+
+                    const float *nq = &g.normals[q * 3];
+                    bool q_hit = nq[0] != 0 || nq[1] != 0 || nq[2] != 0;
+                    float w = kernel[std::abs(dx)] * kernel[std::abs(dy)];
+                    if (p_hit && q_hit)
+                        w *= normal_weight(np[0] * nq[0] + np[1] * nq[1] + np[2] * nq[2]);
+                    else if (p_hit != q_hit)
+                        continue;
+
+                    float lq = luminance_of(&in[q * 3]);
+                    float exponent = std::fabs(lp - lq) / luminance_scale +
+                                     std::fabs(zp - g.depths[q]) / (depth_scale * (std::abs(dx) + std::abs(dy)) + 1e-6f);
+                    w *= std::exp(-exponent);
+
+                    sum[0] += w * in[q * 3];
+                    sum[1] += w * in[q * 3 + 1];
+                    sum[2] += w * in[q * 3 + 2];
+                    weight_sum += w;
+                    var_sum += w * w * in_var[q];
+                }
+            }
+
+            // 中心像素的权重恒为正，weight_sum 不会为 0
+            for (int c = 0; c < 3; c++)
+                out[p * 3 + c] = sum[c] / weight_sum;
+            out_var[p] = clamp_variance(var_sum / (weight_sum * weight_sum));
+        }
+    }
+};
+
+#endif
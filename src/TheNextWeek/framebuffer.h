@@ -0,0 +1,52 @@
+#ifndef FRAMEBUFFER_H
+#define FRAMEBUFFER_H
+
+#include "rtweekend.h"
+
+#include <vector>
+
+// 浮点帧缓冲
+// Linear-radiance RGB image stored as packed floats, row-major from the top scanline. The camera
+// renders into it from any number of threads (each pixel is written by exactly one tile), and the
+// image writers encode it afterwards in one pass.
+class framebuffer
+{
+public:
+    framebuffer() : image_width(0), image_height(0) {}
+    framebuffer(int width, int height) { resize(width, height); }
+
+    void resize(int width, int height)
+    {
+        image_width = width;
+        image_height = height;
+        rgb.assign(size_t(width) * height * 3, 0.0f);
+    }
+
+    int width() const { return image_width; }
+    int height() const { return image_height; }
+    size_t pixel_count() const { return size_t(image_width) * image_height; }
+
+    void set(int x, int y, const color &c)
+    {
+        float *p = &rgb[(size_t(y) * image_width + x) * 3];
+        p[0] = float(c.x());
+        p[1] = float(c.y());
+        p[2] = float(c.z());
+    }
+
+    color get(int x, int y) const
+    {
+        const float *p = &rgb[(size_t(y) * image_width + x) * 3];
+        return color(p[0], p[1], p[2]);
+    }
+
+    // Raw interleaved RGB components, 3 * pixel_count() floats.
+    float *data() { return rgb.data(); }
+    const float *data() const { return rgb.data(); }
+
+private:
+    int image_width, image_height;
+    std::vector<float> rgb;
+};
+
+#endif
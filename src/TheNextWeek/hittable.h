@@ -2,24 +2,66 @@
 #define HITTABLE_H
 #include "rtweekend.h"
 #include "aabb.h"
+#include "ray_packet.h"
+#include "light_bounds.h"
+
+#include <vector>
 
 class material;
+class hittable;
+
+// 从表面上的点 p 发出的光线的起点
+// p_error bounds the rounding error in each component of p, so the true surface lies within
+// dot(|n|, p_error) of p along the normal. Moving p that far along n, to the side w leaves by,
+// and then one more ulp in each component the normal moves, puts the origin strictly on the
+// outgoing side of the surface even where p is exact (PBRT 3.9.5). The new ray can then start at
+// t = 0 and still never hit the surface it left, whatever the scale of the scene, where a fixed
+// t_min is too small far from the origin and too large for small geometry.
+inline point3 offset_ray_origin(const point3 &p, const vec3 &p_error, const vec3 &n, const vec3 &w)
+{
+    vec3 side = dot(w, n) < 0 ? -n : n;
+    point3 origin = p + dot(abs(n), p_error) * side;
+    for (int i = 0; i < 3; i++)
+    {
+        if (side[i] > 0)
+            origin[i] = std::nextafter(origin[i], std::numeric_limits<real>::infinity());
+        else if (side[i] < 0)
+            origin[i] = std::nextafter(origin[i], -std::numeric_limits<real>::infinity());
+    }
+    return origin;
+}
 
 class hit_record
 {
 public:
     point3 p;                     // 点的坐标
+    vec3 p_error;                 // p 各分量的舍入误差界，由图元求交时给出
     vec3 normal;                  // 法向量
-    double t;                     // 相交位置的参数
+    real t;                       // 相交位置的参数
     double u, v;                  // 纹理坐标
     bool front_face;              // 是否为正面相交
-    shared_ptr<material> mat_ptr; // 材质指针
+    const material *mat_ptr = nullptr; // 材质，不持有所有权，由图元的 shared_ptr 保持存活
+    const hittable *object = nullptr; // 被击中的图元，用于识别光源
 
     void set_face_normal(const ray &r, const vec3 &outward_normal)
     {
         front_face = dot(r.direction(), outward_normal) < 0;
         normal = front_face ? outward_normal : -outward_normal;
     }
+
+    // 从交点沿 direction 发出的光线（散射光线、阴影光线），起点已移出表面，可以从 t = 0 开始求交
+    ray spawn_ray(const vec3 &direction, double time) const
+    {
+        return ray(offset_ray_origin(p, p_error, normal, direction), direction, time);
+    }
+};
+
+// 光线包的求交结果，mask 中置位的通道在 rec 中有有效的交点
+class packet_hit
+{
+public:
+    hit_record rec[ray_packet::max_size];
+    unsigned mask = 0;
 };
 
 class hittable
@@ -28,6 +70,36 @@ public:
     virtual ~hittable() = default;
     virtual bool hit(const ray &r, interval ray_t, hit_record &rec) const = 0;
     virtual aabb bounding_box() const = 0;
+
+    // 光源采样（下一事件估计）。pdf_value 是从 origin 沿 direction 看向本图元时、
+    // 按 random() 的分布采样得到该方向的立体角概率密度；random 返回从 origin 指向图元上
+    // 一个随机点的方向（未归一化）。只有会被 collect_emitters 收集的图元需要实现。
+    virtual double pdf_value(const point3 &origin, const vec3 &direction) const { return 0.0; }
+    virtual vec3 random(const point3 &origin) const { return vec3(1, 0, 0); }
+
+    // 把可以直接采样的发光图元追加到 emitters。容器转发给其中的对象；
+    // instance（包括 translate/rotate_y）不转发，其中的光源只能被散射光线偶然击中。
+    virtual void collect_emitters(std::vector<const hittable *> &emitters) const {}
+
+    // 发光图元的空间、功率和朝向包围，供光源 BVH 使用
+    virtual light_bounds emitter_bounds() const { return light_bounds(); }
+
+    // 光线包求交：测试 lanes 中的每条光线，命中时缩短 packet.t_max 并写入 hits。
+    // The default traces the lanes one at a time; primitives and BVHs override it with SoA code.
+    // Overrides must do the same operations, in the same order, as hit() so both paths agree bit
+    // for bit and packet tracing never changes the image.
+    virtual void hit_packet(ray_packet &packet, unsigned lanes, packet_hit &hits) const
+    {
+        for (; lanes; lanes &= lanes - 1)
+        {
+            int k = lowest_lane(lanes);
+            if (hit(packet.rays[k], interval(packet.t_min, packet.t_max[k]), hits.rec[k]))
+            {
+                packet.t_max[k] = hits.rec[k].t;
+                hits.mask |= 1u << k;
+            }
+        }
+    }
 };
 
 #endif
\ No newline at end of file
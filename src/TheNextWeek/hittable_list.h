@@ -49,28 +49,18 @@ public:
 
         return hit_anything; // 返回是否有交点
     }
-    aabb bounding_box() const override
+
+    // 整个光线包依次与每个对象求交，各通道的 t_max 随命中而缩短
+    void hit_packet(ray_packet &packet, unsigned lanes, packet_hit &hits) const override
     {
-        return bbox;
+        for (const auto &object : objects)
+            object->hit_packet(packet, lanes, hits);
     }
 
-private:
-    aabb bbox; // 列表的包围盒
-};
-
-class translate : public hittable
-{
-public:
-    translate(shared_ptr<hittable> object, const vec3 &offset) : object(object), offset(offset) { bbox = object->bounding_box() + offset; }
-
-    bool hit(const ray &r, interval ray_t, hit_record &rec) const override
+    void collect_emitters(std::vector<const hittable *> &emitters) const override
     {
-        ray offset_ray(r.origin() - offset, r.direction(), r.get_time());
-        if (!object->hit(offset_ray, ray_t, rec))
-            return false;
-
-        rec.p += offset;
-        return true;
+        for (const auto &object : objects)
+            object->collect_emitters(emitters);
     }
 
     aabb bounding_box() const override
@@ -79,90 +69,7 @@ public:
     }
 
 private:
-    shared_ptr<hittable> object;
-    vec3 offset;
-    aabb bbox;
-};
-
-class rotate_y : public hittable
-{
-public:
-    rotate_y(shared_ptr<hittable> object, double angle) : object(object)
-    {
-        auto radians = degrees_to_radians(angle);
-        sin_theta = std::sin(radians);
-        cos_theta = std::cos(radians);
-        bbox = object->bounding_box();
-
-        point3 min(infinity, infinity, infinity);
-        point3 max(-infinity, -infinity, -infinity);
-
-        for (int i = 0; i < 2; i++)
-        {
-            for (int j = 0; j < 2; j++)
-            {
-                for (int k = 0; k < 2; k++)
-                {
-                    auto x = i * bbox.x.max + (1 - i) * bbox.x.min;
-                    auto y = j * bbox.y.max + (1 - j) * bbox.y.min;
-                    auto z = k * bbox.z.max + (1 - k) * bbox.z.min;
-
-                    auto newx = cos_theta * x + sin_theta * z;
-                    auto newz = -sin_theta * x + cos_theta * z;
-
-                    vec3 tester(newx, y, newz);
-
-                    for (int c = 0; c < 3; c++)
-                    {
-                        min[c] = std::fmin(min[c], tester[c]);
-                        max[c] = std::fmax(max[c], tester[c]);
-                    }
-                }
-            }
-        }
-
-        bbox = aabb(min, max);
-    }
-    bool hit(const ray &r, interval ray_t, hit_record &rec) const override
-    {
-        // Change the ray from world space to object space
-        auto origin = r.origin();
-        auto direction = r.direction();
-
-        origin[0] = cos_theta * r.origin()[0] - sin_theta * r.origin()[2];
-        origin[2] = sin_theta * r.origin()[0] + cos_theta * r.origin()[2];
-
-        direction[0] = cos_theta * r.direction()[0] - sin_theta * r.direction()[2];
-        direction[2] = sin_theta * r.direction()[0] + cos_theta * r.direction()[2];
-
-        ray rotated_r(origin, direction, r.get_time());
-
-        // Determine whether an intersection exists in object space (and if so, where)
-        if (!object->hit(rotated_r, ray_t, rec))
-            return false;
-
-        // Change the intersection point from object space to world space
-        auto p = rec.p;
-        p[0] = cos_theta * rec.p[0] + sin_theta * rec.p[2];
-        p[2] = -sin_theta * rec.p[0] + cos_theta * rec.p[2];
-
-        // Change the normal from object space to world space
-        auto normal = rec.normal;
-        normal[0] = cos_theta * rec.normal[0] + sin_theta * rec.normal[2];
-        normal[2] = -sin_theta * rec.normal[0] + cos_theta * rec.normal[2];
-
-        rec.p = p;
-        rec.normal = normal;
-
-        return true;
-    }
-    aabb bounding_box() const override { return bbox; }
-
-private:
-    shared_ptr<hittable> object;
-    double sin_theta;
-    double cos_theta;
-    aabb bbox;
+    aabb bbox; // 列表的包围盒
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,233 @@
+#ifndef IMAGE_WRITER_H
+#define IMAGE_WRITER_H
+
+#include "rtweekend.h"
+#include "framebuffer.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+// 图像输出格式
+enum class image_format
+{
+    ppm, // binary P6, 8 bits per channel
+    png, // 8 bits per channel, uncompressed deflate
+    pfm  // 32-bit float per channel, linear radiance
+};
+
+// Picks the format from a file name's extension; anything unrecognised is written as PPM.
+inline image_format image_format_from_path(const std::string &path)
+{
+    auto dot = path.find_last_of('.');
+    std::string ext = (dot == std::string::npos) ? "" : path.substr(dot + 1);
+    for (auto &ch : ext)
+        ch = char(std::tolower((unsigned char)ch));
+
+    if (ext == "png")
+        return image_format::png;
+    if (ext == "pfm")
+        return image_format::pfm;
+    return image_format::ppm;
+}
+
+// Gamma-encodes and quantizes every component of the buffer to [0,255]. The loop body is
+// branch-free over packed floats so the compiler vectorizes it across the whole image.
+inline void quantize_to_bytes(const framebuffer &image, std::vector<unsigned char> &bytes)
+{
+    size_t count = image.pixel_count() * 3;
+    bytes.resize(count);
+
+    const float *src = image.data();
+    unsigned char *dst = bytes.data();
+    for (size_t k = 0; k < count; k++)
+    {
+        // Same mapping as linear_to_gamma(): gamma 2, with values at or below the linear
+        // threshold mapped to black, then clamped to [0, 0.999] before scaling.
+        float linear = src[k];
+        float root = std::sqrt(std::max(linear, 0.0f));
+        float gamma = linear > 0.0031308f ? root : 0.0f;
+        gamma = gamma < 0.999f ? gamma : 0.999f;
+        dst[k] = (unsigned char)int(255.999f * gamma);
+    }
+}
+
+inline bool write_ppm(std::ostream &out, const framebuffer &image)
+{
+    std::vector<unsigned char> bytes;
+    quantize_to_bytes(image, bytes);
+
+    out << "P6\n"
+        << image.width() << ' ' << image.height() << "\n255\n";
+    out.write(reinterpret_cast<const char *>(bytes.data()), std::streamsize(bytes.size()));
+    return bool(out);
+}
+
+inline bool write_pfm(std::ostream &out, const framebuffer &image)
+{
+    // PFM stores scanlines bottom to top; a negative scale marks little-endian data.
+    uint16_t probe = 1;
+    bool little_endian = *reinterpret_cast<unsigned char *>(&probe) == 1;
+
+    size_t row_floats = size_t(image.width()) * 3;
+    std::vector<float> flipped(row_floats * image.height());
+    for (int y = 0; y < image.height(); y++)
+        std::copy(image.data() + size_t(y) * row_floats, image.data() + size_t(y + 1) * row_floats,
+                  flipped.begin() + size_t(image.height() - 1 - y) * row_floats);
+
+    out << "PF\n"
+        << image.width() << ' ' << image.height() << '\n'
+        << (little_endian ? "-1.0" : "1.0") << '\n';
+    out.write(reinterpret_cast<const char *>(flipped.data()), std::streamsize(flipped.size() * sizeof(float)));
+    return bool(out);
+}
+
+namespace png_detail
+{
+    inline uint32_t crc32(const unsigned char *data, size_t length, uint32_t crc = 0)
+    {
+        struct crc_table
+        {
+            uint32_t entries[256];
+            crc_table()
+            {
+                for (uint32_t n = 0; n < 256; n++)
+                {
+                    uint32_t c = n;
+                    for (int k = 0; k < 8; k++)
+                        c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+                    entries[n] = c;
+                }
+            }
+        };
+        static const crc_table table;
+
+        crc = ~crc;
+        for (size_t i = 0; i < length; i++)
+            crc = table.entries[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+        return ~crc;
+    }
+
+    inline void put_u32(std::vector<unsigned char> &out, uint32_t v)
+    {
+        out.push_back((unsigned char)(v >> 24));
+        out.push_back((unsigned char)(v >> 16));
+        out.push_back((unsigned char)(v >> 8));
+        out.push_back((unsigned char)v);
+    }
+
+    inline void put_chunk(std::vector<unsigned char> &out, const char *type, const std::vector<unsigned char> &payload)
+    {
+        put_u32(out, uint32_t(payload.size()));
+        size_t start = out.size();
+        out.insert(out.end(), type, type + 4);
+        out.insert(out.end(), payload.begin(), payload.end());
+        put_u32(out, crc32(&out[start], out.size() - start));
+    }
+}
+
+inline bool write_png(std::ostream &out, const framebuffer &image)
+{
+    std::vector<unsigned char> bytes;
+    quantize_to_bytes(image, bytes);
+
+    // Raw scanlines, each prefixed with filter type 0 (none).
+    size_t row_bytes = size_t(image.width()) * 3;
+    std::vector<unsigned char> raw;
+    raw.reserve((row_bytes + 1) * image.height());
+    for (int y = 0; y < image.height(); y++)
+    {
+        raw.push_back(0);
+        raw.insert(raw.end(), bytes.begin() + y * row_bytes, bytes.begin() + (y + 1) * row_bytes);
+    }
+
+    // zlib stream made of stored (uncompressed) deflate blocks of at most 65535 bytes.
+    std::vector<unsigned char> zlib;
+    zlib.reserve(raw.size() + raw.size() / 65535 * 5 + 16);
+    zlib.push_back(0x78);
+    zlib.push_back(0x01);
+    size_t offset = 0;
+    do
+    {
+        size_t block = std::min<size_t>(65535, raw.size() - offset);
+        bool last = offset + block == raw.size();
+        zlib.push_back(last ? 1 : 0);
+        zlib.push_back((unsigned char)(block & 0xff));
+        zlib.push_back((unsigned char)(block >> 8));
+        zlib.push_back((unsigned char)(~block & 0xff));
+        zlib.push_back((unsigned char)((~block >> 8) & 0xff));
+        zlib.insert(zlib.end(), raw.begin() + offset, raw.begin() + offset + block);
+        offset += block;
+    } while (offset < raw.size());
+
+    uint32_t a = 1, b = 0; // Adler-32 of the uncompressed data
+    for (auto byte : raw)
+    {
+        a = (a + byte) % 65521;
+        b = (b + a) % 65521;
+    }
+    png_detail::put_u32(zlib, (b << 16) | a);
+
+    std::vector<unsigned char> header;
+    png_detail::put_u32(header, uint32_t(image.width()));
+    png_detail::put_u32(header, uint32_t(image.height()));
+    header.push_back(8); // bit depth
+    header.push_back(2); // color type: truecolor RGB
+    header.push_back(0); // compression
+    header.push_back(0); // filter
+    header.push_back(0); // interlace
+
+    static const unsigned char signature[8] = {137, 80, 78, 71, 13, 10, 26, 10};
+    std::vector<unsigned char> file(signature, signature + 8);
+    png_detail::put_chunk(file, "IHDR", header);
+    png_detail::put_chunk(file, "IDAT", zlib);
+    png_detail::put_chunk(file, "IEND", std::vector<unsigned char>());
+
+    out.write(reinterpret_cast<const char *>(file.data()), std::streamsize(file.size()));
+    return bool(out);
+}
+
+inline bool write_image(std::ostream &out, const framebuffer &image, image_format format)
+{
+    switch (format)
+    {
+    case image_format::png:
+        return write_png(out, image);
+    case image_format::pfm:
+        return write_pfm(out, image);
+    default:
+        return write_ppm(out, image);
+    }
+}
+
+// Writes the image to a file, or to standard output when path is empty or "-".
+inline bool write_image(const std::string &path, const framebuffer &image)
+{
+    if (path.empty() || path == "-")
+    {
+#ifdef _WIN32
+        _setmode(_fileno(stdout), _O_BINARY);
+#endif
+        bool ok = write_ppm(std::cout, image);
+        std::cout.flush();
+        return ok;
+    }
+
+    std::ofstream file(path, std::ios::binary);
+    if (!file)
+    {
+        std::cerr << "ERROR: Could not open '" << path << "' for writing.\n";
+        return false;
+    }
+    return write_image(file, image, image_format_from_path(path));
+}
+
+#endif
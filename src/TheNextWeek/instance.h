@@ -0,0 +1,69 @@
+#ifndef INSTANCE_H
+#define INSTANCE_H
+
+#include "rtweekend.h"
+#include "hittable.h"
+#include "transform.h"
+
+// 实例
+// Places a shared object, usually a BVH over its own primitives (the bottom level), in the world
+// with an affine transform. Any number of instances can reference the same object, each costing
+// one transform; putting the instances in a BVHNode of their own gives a two-level structure.
+//
+// The ray is taken into object space once and intersected there. The object-space direction is
+// not renormalised, so t means the same in both spaces and ray_t needs no conversion. Wrapping an
+// instance in another instance multiplies the two matrices instead of nesting the calls.
+class instance : public hittable
+{
+public:
+    instance(shared_ptr<hittable> object, const affine_transform &to_world)
+        : object(object), to_world(to_world)
+    {
+        if (auto inner = dynamic_cast<const instance *>(object.get()))
+        {
+            this->object = inner->object;
+            this->to_world = to_world * inner->to_world;
+        }
+        bbox = this->to_world.box(this->object->bounding_box());
+    }
+
+    bool hit(const ray &r, interval ray_t, hit_record &rec) const override
+    {
+        ray local(to_world.inverse_point(r.origin()), to_world.inverse_vector(r.direction()), r.get_time());
+        if (!object->hit(local, ray_t, rec))
+            return false;
+
+        // The normal keeps the side set_face_normal chose: dot(n', d') = dot(n, d) under the
+        // inverse transpose.
+        rec.p_error = to_world.point_error(rec.p, rec.p_error);
+        rec.p = to_world.point(rec.p);
+        rec.normal = unit_vector(to_world.normal(rec.normal));
+        return true;
+    }
+
+    aabb bounding_box() const override { return bbox; }
+
+    const affine_transform &transform() const { return to_world; }
+
+private:
+    shared_ptr<hittable> object;
+    affine_transform to_world;
+    aabb bbox;
+};
+
+// 平移和绕 y 轴旋转，分别是只含一种变换的实例
+class translate : public instance
+{
+public:
+    translate(shared_ptr<hittable> object, const vec3 &offset)
+        : instance(object, affine_transform::translation(offset)) {}
+};
+
+class rotate_y : public instance
+{
+public:
+    rotate_y(shared_ptr<hittable> object, double angle)
+        : instance(object, affine_transform::rotation_y(angle)) {}
+};
+
+#endif
@@ -2,49 +2,52 @@
 #define INTERVAL_H
 #include <limits>
 
-class interval
+// 区间，按标量类型 T 模板化；渲染器用的是 interval = basic_interval<real>
+template <typename T>
+class basic_interval
 {
 public:
-    double min, max;
+    typedef T value_type;
 
-    interval() : min(+infinity), max(-infinity) {} // 默认区间为空
+    T min, max;
 
-    interval(double _min, double _max) : min(_min), max(_max) {}
+    basic_interval() : min(+infinity), max(-infinity) {} // 默认区间为空
 
-    interval(const interval &a, const interval &b)
+    basic_interval(T _min, T _max) : min(_min), max(_max) {}
+
+    basic_interval(const basic_interval &a, const basic_interval &b)
     {
         min = a.min < b.min ? a.min : b.min;
         max = a.max > b.max ? a.max : b.max;
     }
 
     // 返回区间的大小
-    double
-    size() const
+    T size() const
     {
         return max - min;
     }
 
     // 扩展区间
-    interval expand(double delta) const
+    basic_interval expand(T delta) const
     {
         auto padding = delta / 2;
-        return interval(min - padding, max + padding);
+        return basic_interval(min - padding, max + padding);
     }
 
     // 判断是否包含特定值
-    bool contains(double x) const
+    bool contains(T x) const
     {
         return min <= x && x <= max;
     }
 
     // 判断是否包围特定值
-    bool surrounds(double x) const
+    bool surrounds(T x) const
     {
         return min < x && x < max;
     }
 
     // 将特定值限制在区间内
-    double clamp(double x) const
+    T clamp(T x) const
     {
         if (x < min)
             return min;
@@ -54,20 +57,26 @@ public:
     }
 
     // 空区间和全区间的静态定义
-    static const interval empty, universe;
+    static const basic_interval empty, universe;
 };
 
-const interval interval::empty = interval(+infinity, -infinity);    // 空区间的定义
-const interval interval::universe = interval(-infinity, +infinity); // 全区间的定义
+template <typename T>
+const basic_interval<T> basic_interval<T>::empty = basic_interval<T>(+infinity, -infinity);    // 空区间的定义
+template <typename T>
+const basic_interval<T> basic_interval<T>::universe = basic_interval<T>(-infinity, +infinity); // 全区间的定义
+
+typedef basic_interval<real> interval;
 
-interval operator+(const interval &ival, double displacement)
+template <typename T>
+basic_interval<T> operator+(const basic_interval<T> &ival, typename basic_interval<T>::value_type displacement)
 {
-    return interval(ival.min + displacement, ival.max + displacement);
+    return basic_interval<T>(ival.min + displacement, ival.max + displacement);
 }
 
-interval operator+(double displacement, const interval &ival)
+template <typename T>
+basic_interval<T> operator+(typename basic_interval<T>::value_type displacement, const basic_interval<T> &ival)
 {
     return ival + displacement;
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,145 @@
+#ifndef LIGHT_BOUNDS_H
+#define LIGHT_BOUNDS_H
+
+#include "rtweekend.h"
+#include "aabb.h"
+
+// 光源的空间与朝向包围
+// Spatial bounds, emitted power and a cone bounding the emission directions of one light or a
+// cluster of lights, as used by the light BVH of PBRT v4 (Conty Estevez and Kulla, "Importance
+// Sampling of Many Lights with Adaptive Tree Splitting", 2018). Surface normals lie within
+// cos_theta_o of `axis`, and each point emits into directions up to cos_theta_e away from its
+// normal (0 for diffuse emitters).
+struct light_bounds
+{
+    aabb bounds = aabb::empty;
+    double phi = 0;            // 总发射功率（亮度）
+    vec3 axis = vec3(0, 0, 1); // 法线锥的轴
+    double cos_theta_o = 1;    // 法线锥的半角余弦，-1 表示任意方向
+    double cos_theta_e = 0;    // 发射方向相对法线的最大夹角余弦
+    bool two_sided = false;
+
+    // Conservative estimate of this cluster's contribution to a point p with normal n (n may be
+    // zero for points without a surface).
+    double importance(const point3 &p, const vec3 &n) const
+    {
+        if (phi <= 0)
+            return 0;
+
+        point3 pc = bounds.centroid();
+        vec3 diagonal(bounds.x.size(), bounds.y.size(), bounds.z.size());
+        double d2 = (p - pc).length_squared();
+        d2 = std::max(d2, double(diagonal.length()) / 2);
+
+        vec3 wi = unit_vector(p - pc);
+        double cos_theta_w = dot(axis, wi);
+        if (two_sided)
+            cos_theta_w = std::fabs(cos_theta_w);
+        double sin_theta_w = safe_sqrt(1 - cos_theta_w * cos_theta_w);
+
+        // Half-angle of the cone of directions from p that can reach the bounds.
+        double cos_theta_b = bound_subtended_cos(p);
+        double sin_theta_b = safe_sqrt(1 - cos_theta_b * cos_theta_b);
+
+        // theta' = max(0, theta_w - theta_o - theta_b)
+        double sin_theta_o = safe_sqrt(1 - cos_theta_o * cos_theta_o);
+        double cos_theta_x = cos_sub_clamped(sin_theta_w, cos_theta_w, sin_theta_o, cos_theta_o);
+        double sin_theta_x = sin_sub_clamped(sin_theta_w, cos_theta_w, sin_theta_o, cos_theta_o);
+        double cos_theta_p = cos_sub_clamped(sin_theta_x, cos_theta_x, sin_theta_b, cos_theta_b);
+        if (cos_theta_p <= cos_theta_e)
+            return 0;
+
+        double result = phi * cos_theta_p / d2;
+
+        // The receiving surface's cosine, with the same conservative widening.
+        if (n.length_squared() > 0)
+        {
+            double cos_theta_i = std::fabs(dot(wi, n));
+            double sin_theta_i = safe_sqrt(1 - cos_theta_i * cos_theta_i);
+            result *= cos_sub_clamped(sin_theta_i, cos_theta_i, sin_theta_b, cos_theta_b);
+        }
+        return std::max(result, 0.0);
+    }
+
+    static light_bounds merge(const light_bounds &a, const light_bounds &b)
+    {
+        if (a.phi <= 0)
+            return b;
+        if (b.phi <= 0)
+            return a;
+
+        light_bounds result;
+        result.bounds = aabb(a.bounds, b.bounds);
+        result.phi = a.phi + b.phi;
+        merge_cones(a.axis, a.cos_theta_o, b.axis, b.cos_theta_o, result.axis, result.cos_theta_o);
+        result.cos_theta_e = std::min(a.cos_theta_e, b.cos_theta_e);
+        result.two_sided = a.two_sided || b.two_sided;
+        return result;
+    }
+
+private:
+    static double safe_sqrt(double x) { return std::sqrt(std::max(0.0, x)); }
+
+    // cos(max(0, a - b)) and sin(max(0, a - b)) from the sines and cosines of a and b.
+    static double cos_sub_clamped(double sin_a, double cos_a, double sin_b, double cos_b)
+    {
+        return cos_a > cos_b ? 1 : cos_a * cos_b + sin_a * sin_b;
+    }
+
+    static double sin_sub_clamped(double sin_a, double cos_a, double sin_b, double cos_b)
+    {
+        return cos_a > cos_b ? 0 : sin_a * cos_b - cos_a * sin_b;
+    }
+
+    double bound_subtended_cos(const point3 &p) const
+    {
+        point3 center = bounds.centroid();
+        vec3 half_diagonal(bounds.x.size() / 2, bounds.y.size() / 2, bounds.z.size() / 2);
+        double radius2 = half_diagonal.length_squared();
+        double distance2 = (p - center).length_squared();
+        if (distance2 < radius2)
+            return -1; // p is inside the bounding sphere
+        return safe_sqrt(1 - radius2 / distance2);
+    }
+
+    // Smallest cone containing both cones (PBRT v4, DirectionCone Union).
+    static void merge_cones(const vec3 &wa, double cos_a, const vec3 &wb, double cos_b, vec3 &w, double &cos_o)
+    {
+        w = wa;
+        cos_o = -1;
+        if (cos_a == -1 || cos_b == -1)
+            return;
+
+        double theta_a = std::acos(std::max(-1.0, std::min(1.0, cos_a)));
+        double theta_b = std::acos(std::max(-1.0, std::min(1.0, cos_b)));
+        double theta_d = std::acos(std::max(-1.0, std::min(1.0, double(dot(wa, wb)))));
+
+        if (std::min(theta_d + theta_b, pi) <= theta_a)
+        {
+            cos_o = cos_a;
+            return;
+        }
+        if (std::min(theta_d + theta_a, pi) <= theta_b)
+        {
+            w = wb;
+            cos_o = cos_b;
+            return;
+        }
+
+        double theta_o = (theta_a + theta_d + theta_b) / 2;
+        if (theta_o >= pi)
+            return;
+
+        // Rotate wa towards wb by theta_o - theta_a (Rodrigues' formula).
+        vec3 rotation_axis = cross(wa, wb);
+        if (rotation_axis.length_squared() == 0)
+            return;
+        rotation_axis = unit_vector(rotation_axis);
+        double theta_r = theta_o - theta_a;
+        w = wa * std::cos(theta_r) + cross(rotation_axis, wa) * std::sin(theta_r) +
+            rotation_axis * dot(rotation_axis, wa) * (1 - std::cos(theta_r));
+        cos_o = std::cos(theta_o);
+    }
+};
+
+#endif
@@ -0,0 +1,158 @@
+#ifndef LIGHT_BVH_H
+#define LIGHT_BVH_H
+
+#include "rtweekend.h"
+#include "hittable.h"
+#include "light_bounds.h"
+#include "light_sampler.h"
+#include "bvh_builder.h"
+
+#include <cstdint>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+// 光源 BVH
+// A binary tree over the emitters with one light per leaf. Every node stores the merged
+// light_bounds of its subtree. Sampling walks down from the root and at each node picks a child
+// in proportion to its importance at the shading point, so lights are chosen roughly by their
+// contribution at O(log n) cost. pmf() recomputes the same choices by walking up from the
+// light's leaf through the parent links. The topology comes from the same binned SAH builder as
+// the geometry BVHs, run over the lights' bounding boxes.
+class light_bvh : public light_sampler
+{
+public:
+    explicit light_bvh(const std::vector<const hittable *> &emitters)
+    {
+        std::vector<light_bounds> bounds;
+        std::vector<aabb> boxes;
+        for (auto emitter : emitters)
+        {
+            light_bounds lb = emitter->emitter_bounds();
+            if (lb.phi <= 0)
+                continue; // emits nothing it could be sampled for
+            lights.push_back(emitter);
+            bounds.push_back(lb);
+            boxes.push_back(lb.bounds);
+        }
+        if (lights.empty())
+            return;
+
+        bvh_build_options options;
+        options.max_leaf_size = 1;
+        bvh_builder builder(boxes, options);
+        auto root = builder.build();
+        nodes.reserve(builder.node_count());
+        flatten(*root, builder.ordered_indices(), bounds, -1);
+    }
+
+    const hittable *sample(const point3 &p, const vec3 &n, double u, double &pmf) const override
+    {
+        pmf = 0;
+        if (nodes.empty())
+            return nullptr;
+
+        const double one_minus_epsilon = 1.0 - std::numeric_limits<double>::epsilon() / 2;
+        double probability = 1;
+        uint32_t index = 0;
+        while (true)
+        {
+            const light_node &node = nodes[index];
+            if (node.is_leaf)
+            {
+                if (index > 0 || node.bounds.importance(p, n) > 0)
+                {
+                    pmf = probability;
+                    return lights[node.child];
+                }
+                return nullptr;
+            }
+
+            double left = nodes[index + 1].bounds.importance(p, n);
+            double right = nodes[node.child].bounds.importance(p, n);
+            if (left + right <= 0)
+                return nullptr;
+
+            // Choose a child and remap u so it can be reused further down.
+            double p_left = left / (left + right);
+            if (u < p_left)
+            {
+                u = std::min(u / p_left, one_minus_epsilon);
+                probability *= p_left;
+                index = index + 1;
+            }
+            else
+            {
+                u = std::min((u - p_left) / (1 - p_left), one_minus_epsilon);
+                probability *= 1 - p_left;
+                index = node.child;
+            }
+        }
+    }
+
+    double pmf(const point3 &p, const vec3 &n, const hittable *light) const override
+    {
+        auto found = leaf_of.find(light);
+        if (found == leaf_of.end())
+            return 0;
+
+        uint32_t index = found->second;
+        if (index == 0)
+            return nodes[0].bounds.importance(p, n) > 0 ? 1 : 0;
+
+        double probability = 1;
+        while (nodes[index].parent >= 0)
+        {
+            uint32_t parent = uint32_t(nodes[index].parent);
+            double left = nodes[parent + 1].bounds.importance(p, n);
+            double right = nodes[nodes[parent].child].bounds.importance(p, n);
+            if (left + right <= 0)
+                return 0;
+            probability *= (index == parent + 1 ? left : right) / (left + right);
+            index = parent;
+        }
+        return probability;
+    }
+
+    bool empty() const override { return lights.empty(); }
+
+private:
+    struct light_node
+    {
+        light_bounds bounds;
+        uint32_t child;  // interior: second child (the first is the next node); leaf: index into lights
+        int32_t parent;  // -1 for the root
+        bool is_leaf;
+    };
+
+    std::vector<const hittable *> lights;
+    std::vector<light_node> nodes;
+    std::unordered_map<const hittable *, uint32_t> leaf_of;
+
+    uint32_t flatten(const bvh_build_node &build, const std::vector<size_t> &order,
+                     const std::vector<light_bounds> &bounds, int32_t parent)
+    {
+        uint32_t index = uint32_t(nodes.size());
+        nodes.push_back(light_node());
+        nodes[index].parent = parent;
+
+        if (build.is_leaf())
+        {
+            size_t light = order[build.first];
+            nodes[index].bounds = bounds[light];
+            nodes[index].child = uint32_t(light);
+            nodes[index].is_leaf = true;
+            leaf_of[lights[light]] = index;
+            return index;
+        }
+
+        flatten(*build.left, order, bounds, int32_t(index));
+        uint32_t second = flatten(*build.right, order, bounds, int32_t(index));
+        nodes[index].bounds = light_bounds::merge(nodes[index + 1].bounds, nodes[second].bounds);
+        nodes[index].child = second;
+        nodes[index].is_leaf = false;
+        return index;
+    }
+};
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef LIGHT_SAMPLER_H
+#define LIGHT_SAMPLER_H
+
+#include "rtweekend.h"
+#include "hittable.h"
+
+#include <algorithm>
+#include <unordered_set>
+#include <vector>
+
+// 光源选择
+// Picks one emitter per shading point for next-event estimation. pmf() must return the
+// probability that sample() picks `light` at the same shading point, so that BSDF-sampled hits on
+// an emitter can be MIS-weighted against light sampling. Emitters the sampler does not know get a
+// pmf of 0.
+class light_sampler
+{
+public:
+    virtual ~light_sampler() = default;
+
+    // u is a uniform number in [0,1); pmf receives the probability of the returned light.
+    virtual const hittable *sample(const point3 &p, const vec3 &n, double u, double &pmf) const = 0;
+    virtual double pmf(const point3 &p, const vec3 &n, const hittable *light) const = 0;
+    virtual bool empty() const = 0;
+};
+
+// 均匀地选择光源
+class uniform_light_sampler : public light_sampler
+{
+public:
+    explicit uniform_light_sampler(const std::vector<const hittable *> &emitters)
+        : lights(emitters), known(emitters.begin(), emitters.end()) {}
+
+    const hittable *sample(const point3 &p, const vec3 &n, double u, double &pmf) const override
+    {
+        if (lights.empty())
+        {
+            pmf = 0;
+            return nullptr;
+        }
+        size_t index = std::min(size_t(u * lights.size()), lights.size() - 1);
+        pmf = 1.0 / lights.size();
+        return lights[index];
+    }
+
+    double pmf(const point3 &p, const vec3 &n, const hittable *light) const override
+    {
+        return known.count(light) ? 1.0 / lights.size() : 0.0;
+    }
+
+    bool empty() const override { return lights.empty(); }
+
+private:
+    std::vector<const hittable *> lights;
+    std::unordered_set<const hittable *> known;
+};
+
+#endif
@@ -0,0 +1,315 @@
+#ifndef LINEAR_BVH_H
+#define LINEAR_BVH_H
+
+#include "rtweekend.h"
+#include "aabb.h"
+#include "bvh_builder.h"
+#include "ray_packet.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+// 线性 BVH 节点，32 字节
+// Bounds are stored as floats rounded outwards, so a node can only ever be larger than the
+// boxes it was built from. Nodes are laid out depth-first: an interior node's first child is
+// the next node in the array and `offset` holds the index of its second child. A leaf stores
+// the first of its `count` primitives in `offset`.
+struct linear_bvh_node
+{
+    float bounds_min[3];
+    float bounds_max[3];
+    uint32_t offset;
+    uint16_t count; // 0 for interior nodes
+    uint8_t axis;   // split axis of an interior node
+    uint8_t pad;
+};
+
+static_assert(sizeof(linear_bvh_node) == 32, "linear_bvh_node must stay 32 bytes");
+
+// Per-ray values the slab test needs, computed once per traversal instead of once per box.
+struct ray_traversal
+{
+    point3 origin;
+    vec3 inv_dir;
+    int dir_is_neg[3];
+
+    explicit ray_traversal(const ray &r) : origin(r.origin())
+    {
+        for (int axis = 0; axis < 3; axis++)
+        {
+            inv_dir[axis] = 1 / r.direction()[axis];
+            dir_is_neg[axis] = inv_dir[axis] < 0;
+        }
+    }
+};
+
+// Array-of-nodes BVH shared by every primitive container. It owns only the node array; the
+// caller keeps its primitives in leaf order and supplies a leaf callback during traversal.
+// view() wraps nodes stored elsewhere, such as a memory-mapped cache file, without copying them.
+class linear_bvh
+{
+public:
+    // Deep enough for any tree bvh_builder produces (it switches to median splits well before).
+    static const int stack_size = 96;
+
+    linear_bvh() {}
+
+    explicit linear_bvh(const bvh_build_node &root, size_t node_count = 0)
+    {
+        if (root.is_leaf() && root.count == 0)
+            return; // no primitives
+        nodes.reserve(node_count);
+        flatten(root);
+    }
+
+    // 不持有节点的 BVH；nodes 必须比它活得久
+    static linear_bvh view(const linear_bvh_node *nodes, size_t count)
+    {
+        linear_bvh bvh;
+        bvh.external = count ? nodes : nullptr;
+        bvh.external_count = count;
+        return bvh;
+    }
+
+    // Checks nodes read from a file before they are traversed: every child and primitive range in
+    // bounds, second children after their parent (so traversal terminates) and no path deeper
+    // than the traversal stacks.
+    bool valid(size_t primitive_count) const
+    {
+        const linear_bvh_node *base = data();
+        size_t n = size();
+        std::vector<uint8_t> depth(n, 0);
+        for (size_t i = 0; i < n; i++)
+        {
+            const linear_bvh_node &node = base[i];
+            if (node.count > 0)
+            {
+                if (node.offset > primitive_count || node.count > primitive_count - node.offset)
+                    return false;
+                continue;
+            }
+            if (node.axis > 2 || node.offset <= i + 1 || node.offset >= n || depth[i] + 1 >= stack_size)
+                return false;
+            uint8_t child = uint8_t(depth[i] + 1);
+            depth[i + 1] = std::max(depth[i + 1], child);
+            depth[node.offset] = std::max(depth[node.offset], child);
+        }
+        return true;
+    }
+
+    bool empty() const { return size() == 0; }
+    size_t size() const { return external ? external_count : nodes.size(); }
+    const linear_bvh_node *data() const { return external ? external : nodes.data(); }
+    const linear_bvh_node &node(size_t i) const { return data()[i]; }
+
+    aabb bounding_box() const
+    {
+        if (empty())
+            return aabb::empty;
+        const linear_bvh_node &root = data()[0];
+        return aabb(interval(root.bounds_min[0], root.bounds_max[0]),
+                    interval(root.bounds_min[1], root.bounds_max[1]),
+                    interval(root.bounds_min[2], root.bounds_max[2]));
+    }
+
+    static bool hit_node(const linear_bvh_node &n, const ray_traversal &rt, interval ray_t)
+    {
+        RT_STAT(thread_stats().node_visits++; thread_stats().box_tests++);
+        for (int axis = 0; axis < 3; axis++)
+        {
+            real t0 = (n.bounds_min[axis] - rt.origin[axis]) * rt.inv_dir[axis];
+            real t1 = (n.bounds_max[axis] - rt.origin[axis]) * rt.inv_dir[axis];
+            if (rt.dir_is_neg[axis])
+                std::swap(t0, t1);
+            t1 *= aabb::far_scale;
+
+            if (t0 > ray_t.min)
+                ray_t.min = t0;
+            if (t1 < ray_t.max)
+                ray_t.max = t1;
+            if (ray_t.max <= ray_t.min)
+                return false;
+        }
+        return true;
+    }
+
+    // Visits the nearer child first and narrows ray_t.max as hits are found, so subtrees behind
+    // the closest hit so far are culled by the slab test. leaf(first, count, ray_t) must test its
+    // primitives against ray_t, shrink ray_t.max to any hit and return whether it hit. `start`
+    // restricts the walk to one subtree.
+    template <typename LeafFn>
+    bool traverse(const ray &r, interval &ray_t, LeafFn &&leaf, uint32_t start = 0) const
+    {
+        if (empty())
+            return false;
+
+        const linear_bvh_node *base = data();
+        ray_traversal rt(r);
+        uint32_t stack[stack_size];
+        int stack_top = 0;
+        uint32_t current = start;
+        bool hit_anything = false;
+
+        while (true)
+        {
+            const linear_bvh_node &n = base[current];
+            if (hit_node(n, rt, ray_t))
+            {
+                if (n.count > 0)
+                {
+                    if (leaf(n.offset, n.count, ray_t))
+                        hit_anything = true;
+                }
+                else
+                {
+                    // Push the far child, descend into the near one.
+                    if (rt.dir_is_neg[n.axis])
+                    {
+                        stack[stack_top++] = current + 1;
+                        current = n.offset;
+                    }
+                    else
+                    {
+                        stack[stack_top++] = n.offset;
+                        current = current + 1;
+                    }
+                    continue;
+                }
+            }
+
+            if (stack_top == 0)
+                break;
+            current = stack[--stack_top];
+        }
+
+        return hit_anything;
+    }
+
+    // Slab-tests every lane of a packet against one node; returns the lanes (within `lanes`) that
+    // overlap it. The loop runs over the full packet width with selects instead of branches (and
+    // instead of std::fmin/fmax, which are library calls) so it vectorizes; each lane makes the
+    // same comparisons as the single-ray test above.
+    static unsigned hit_node(const linear_bvh_node &n, const ray_packet &packet, unsigned lanes)
+    {
+        RT_STAT(thread_stats().node_visits += lane_count(lanes); thread_stats().box_tests += lane_count(lanes));
+        long long overlap[ray_packet::max_size];
+        for (int k = 0; k < ray_packet::max_size; k++)
+        {
+            real t0 = packet.t_min, t1 = packet.t_max[k];
+            slab(n.bounds_min[0], n.bounds_max[0], packet.org_x[k], packet.inv_x[k], t0, t1);
+            slab(n.bounds_min[1], n.bounds_max[1], packet.org_y[k], packet.inv_y[k], t0, t1);
+            slab(n.bounds_min[2], n.bounds_max[2], packet.org_z[k], packet.inv_z[k], t0, t1);
+            overlap[k] = t1 > t0;
+        }
+
+        unsigned mask = 0;
+        for (int k = 0; k < ray_packet::max_size; k++)
+            mask |= unsigned(overlap[k]) << k;
+        return mask & lanes;
+    }
+
+    // Packet traversal. All lanes walk the tree together and share each node fetch; a subtree
+    // reached by fewer than min_lanes lanes is handed to single(lane, node) to finish per ray.
+    // leaf(first, count, lanes) tests a leaf's primitives against the given lanes.
+    template <typename LeafFn, typename SingleFn>
+    void traverse_packet(const ray_packet &packet, unsigned lanes, int min_lanes, LeafFn &&leaf, SingleFn &&single) const
+    {
+        if (empty())
+            return;
+
+        const linear_bvh_node *base = data();
+        struct entry
+        {
+            uint32_t node;
+            unsigned lanes;
+        };
+        entry stack[stack_size];
+        int stack_top = 0;
+        stack[stack_top++] = entry{0, lanes};
+
+        while (stack_top > 0)
+        {
+            entry e = stack[--stack_top];
+            const linear_bvh_node &n = base[e.node];
+
+            unsigned active = hit_node(n, packet, e.lanes);
+            if (!active)
+                continue;
+
+            if (lane_count(active) < min_lanes)
+            {
+                for (; active; active &= active - 1)
+                    single(lowest_lane(active), e.node);
+                continue;
+            }
+
+            if (n.count > 0)
+            {
+                leaf(n.offset, n.count, active);
+                continue;
+            }
+
+            // Order the children by the direction of the first active lane.
+            int k = lowest_lane(active);
+            real dir = n.axis == 0 ? packet.dir_x[k] : (n.axis == 1 ? packet.dir_y[k] : packet.dir_z[k]);
+            if (dir < 0)
+            {
+                stack[stack_top++] = entry{e.node + 1, active};
+                stack[stack_top++] = entry{n.offset, active};
+            }
+            else
+            {
+                stack[stack_top++] = entry{n.offset, active};
+                stack[stack_top++] = entry{e.node + 1, active};
+            }
+        }
+    }
+
+private:
+    std::vector<linear_bvh_node> nodes;
+    const linear_bvh_node *external = nullptr; // view() 时指向外部的节点
+    size_t external_count = 0;
+
+    static void slab(real lo, real hi, real origin, real inv_dir, real &t0, real &t1)
+    {
+        real near_t = ((inv_dir < 0 ? hi : lo) - origin) * inv_dir;
+        real far_t = ((inv_dir < 0 ? lo : hi) - origin) * inv_dir * aabb::far_scale;
+        t0 = near_t > t0 ? near_t : t0;
+        t1 = far_t < t1 ? far_t : t1;
+    }
+
+    uint32_t flatten(const bvh_build_node &build)
+    {
+        uint32_t index = uint32_t(nodes.size());
+        nodes.push_back(linear_bvh_node());
+
+        linear_bvh_node n;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            const interval &extent = build.bbox.axis_interval(axis);
+            n.bounds_min[axis] = round_down_to_float(extent.min);
+            n.bounds_max[axis] = round_up_to_float(extent.max);
+        }
+        n.axis = uint8_t(build.axis);
+        n.pad = 0;
+
+        if (build.is_leaf())
+        {
+            n.offset = uint32_t(build.first);
+            n.count = uint16_t(build.count);
+        }
+        else
+        {
+            n.count = 0;
+            flatten(*build.left);
+            n.offset = flatten(*build.right);
+        }
+
+        nodes[index] = n;
+        return index;
+    }
+};
+
+#endif
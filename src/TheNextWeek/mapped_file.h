@@ -0,0 +1,141 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// 只读内存映射文件
+// Maps a whole file into the address space so parsers can read it as one block of bytes without
+// copying it into a buffer first; pages are brought in by the OS as they are touched, and several
+// threads can parse different parts at once. Where mapping fails (an empty file, a pipe) the file
+// is read into memory instead, so callers never need a second code path.
+//
+// A copy-on-write mapping can also be written through mutable_data(); written pages become private
+// copies and the file itself never changes. Data used in place, like a cache file's arrays, can
+// then sit behind the same non-const pointers as data built in memory.
+class mapped_file
+{
+public:
+    mapped_file() {}
+    explicit mapped_file(const std::string &path, bool copy_on_write = false) { open(path, copy_on_write); }
+    ~mapped_file() { close(); }
+
+    mapped_file(const mapped_file &) = delete;
+    mapped_file &operator=(const mapped_file &) = delete;
+
+    // 成功时返回 true；失败时 data() 为空
+    bool open(const std::string &path, bool copy_on_write = false)
+    {
+        close();
+#if defined(_WIN32)
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                           FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+            return false;
+        LARGE_INTEGER size;
+        if (GetFileSizeEx(file, &size) && size.QuadPart > 0)
+        {
+            mapping = CreateFileMappingA(file, nullptr, copy_on_write ? PAGE_WRITECOPY : PAGE_READONLY, 0, 0, nullptr);
+            if (mapping)
+            {
+                bytes = static_cast<char *>(MapViewOfFile(mapping, copy_on_write ? FILE_MAP_COPY : FILE_MAP_READ, 0, 0, 0));
+                if (bytes)
+                {
+                    length = size_t(size.QuadPart);
+                    return true;
+                }
+            }
+        }
+#else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat info;
+        if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0)
+        {
+            int protection = copy_on_write ? PROT_READ | PROT_WRITE : PROT_READ;
+            void *p = mmap(nullptr, size_t(info.st_size), protection, MAP_PRIVATE, fd, 0);
+            if (p != MAP_FAILED)
+            {
+                ::close(fd);
+                bytes = static_cast<char *>(p);
+                length = size_t(info.st_size);
+                mapped = true;
+                return true;
+            }
+        }
+        ::close(fd);
+#endif
+        close();
+        return read_whole(path);
+    }
+
+    void close()
+    {
+#if defined(_WIN32)
+        if (bytes && buffer.empty())
+            UnmapViewOfFile(bytes);
+        if (mapping)
+            CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE)
+            CloseHandle(file);
+        mapping = nullptr;
+        file = INVALID_HANDLE_VALUE;
+#else
+        if (mapped)
+            munmap(bytes, length);
+        mapped = false;
+#endif
+        std::vector<char>().swap(buffer);
+        bytes = nullptr;
+        length = 0;
+    }
+
+    bool is_open() const { return bytes != nullptr || !buffer.empty(); }
+    const char *data() const { return bytes; }
+    char *mutable_data() { return bytes; } // 只对以写时复制方式打开的文件可写
+    size_t size() const { return length; }
+    const char *begin() const { return bytes; }
+    const char *end() const { return bytes + length; }
+
+private:
+    char *bytes = nullptr;
+    size_t length = 0;
+    std::vector<char> buffer; // 不能映射时的文件内容
+#if defined(_WIN32)
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#else
+    bool mapped = false;
+#endif
+
+    bool read_whole(const std::string &path)
+    {
+        std::ifstream in(path, std::ios::binary);
+        if (!in)
+            return false;
+        buffer.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        // An empty file opens successfully with data() pointing at a valid, empty range.
+        buffer.push_back('\0');
+        bytes = buffer.data();
+        length = buffer.size() - 1;
+        return true;
+    }
+};
+
+#endif
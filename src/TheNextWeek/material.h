@@ -16,6 +16,23 @@ public:
 
     // 散射函数，根据入射光线和击中记录计算散射后的衰减和散射光线
     virtual bool scatter(const ray &r_in, const hit_record &rec, color &attenuation, ray &scattered) const = 0;
+
+    // 是否发光；发光的图元会被收集起来做光源采样
+    virtual bool is_emissive() const { return false; }
+
+    // scatter() 采样 scattered 方向的立体角概率密度。scatter() 返回的 attenuation 是
+    // BRDF * cos / pdf，所以 attenuation * scattering_pdf 就是任意方向上的 BRDF * cos，
+    // 光源采样用它来求值。
+    virtual double scattering_pdf(const ray &r_in, const hit_record &rec, const ray &scattered) const { return 0; }
+
+    // 散射分布无法按方向求值（镜面反射、折射）时为 true，这类表面不做光源采样
+    virtual bool is_specular() const { return true; }
+
+    // 表面的反照率，写入去噪用的 albedo 缓冲；没有明确颜色的材质（玻璃、光源）为 1
+    virtual color surface_albedo(const hit_record &rec) const { return color(1, 1, 1); }
+
+    // 类型名，渲染统计按它分类击中次数
+    virtual const char *type_name() const { return "material"; }
 };
 
 // Lambertian类继承自material类
@@ -40,6 +57,19 @@ public:
         return true;
     }
 
+    // 余弦分布：pdf = cos(theta) / pi
+    double scattering_pdf(const ray &r_in, const hit_record &rec, const ray &scattered) const override
+    {
+        auto cos_theta = dot(rec.normal, unit_vector(scattered.direction()));
+        return cos_theta < 0 ? 0 : cos_theta / pi;
+    }
+
+    bool is_specular() const override { return false; }
+
+    color surface_albedo(const hit_record &rec) const override { return tex->value(rec.u, rec.v, rec.p); }
+
+    const char *type_name() const override { return "lambertian"; }
+
 private:
     // 材质的颜色属性
 
@@ -61,6 +91,10 @@ public:
         return (dot(scattered.direction(), rec.normal) > 0);
     }
 
+    color surface_albedo(const hit_record &rec) const override { return albedo; }
+
+    const char *type_name() const override { return "metal"; }
+
 private:
     color albedo;
     double fuzz;
@@ -102,6 +136,8 @@ public:
         return true;
     }
 
+    const char *type_name() const override { return "dielectric"; }
+
 private:
     double refraction_index; // 折射率
     // 计算反射率的方法
@@ -131,6 +167,10 @@ public:
         return tex->value(u, v, p);
     }
 
+    bool is_emissive() const override { return true; }
+
+    const char *type_name() const override { return "diffuse_light"; }
+
 private:
     shared_ptr<texture> tex;
 };
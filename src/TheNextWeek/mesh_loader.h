@@ -0,0 +1,732 @@
+#ifndef MESH_LOADER_H
+#define MESH_LOADER_H
+
+#include "rtweekend.h"
+#include "mapped_file.h"
+#include "thread_pool.h"
+#include "triangle_mesh.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// 网格文件读取
+// OBJ and binary PLY loaders that read straight from a memory-mapped file and split the work
+// across a thread pool. An OBJ file is cut into blocks at line boundaries; one parallel pass
+// counts the vertex lines in each block, so every block knows where its vertices go in the
+// shared arrays (and how to resolve relative indices), and a second pass parses the blocks in
+// place. PLY vertices have a fixed size and are decoded in parallel directly; faces are lists, so
+// one quick sequential walk records where each block of faces starts before they are decoded in
+// parallel too. Polygons are triangulated as fans. Failures are reported on std::cerr and leave
+// the loader returning false.
+namespace mesh_parse
+{
+    static const size_t obj_block_size = size_t(1) << 20; // OBJ 每块的字节数
+    static const size_t ply_block_items = 1 << 16;        // PLY 每块的顶点或面数
+
+    inline bool is_blank(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+    inline bool is_digit(char c) { return c >= '0' && c <= '9'; }
+
+    inline const char *skip_blanks(const char *p, const char *end)
+    {
+        while (p < end && is_blank(*p))
+            p++;
+        return p;
+    }
+
+    // 下一行的开头
+    inline const char *next_line(const char *p, const char *end)
+    {
+        const char *newline = static_cast<const char *>(std::memchr(p, '\n', size_t(end - p)));
+        return newline ? newline + 1 : end;
+    }
+
+    // Decimal number in the C locale. Seventeen significant digits are kept, which is more than
+    // the float the value ends up in can hold; failure leaves p unchanged.
+    inline bool parse_double(const char *&p, const char *end, double &out)
+    {
+        static const double powers[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+        const char *q = skip_blanks(p, end);
+        bool negative = false;
+        if (q < end && (*q == '-' || *q == '+'))
+            negative = *q++ == '-';
+
+        uint64_t mantissa = 0;
+        int digits = 0, exponent = 0;
+        bool any = false;
+        for (; q < end && is_digit(*q); q++, any = true)
+        {
+            if (digits < 17)
+            {
+                mantissa = mantissa * 10 + uint64_t(*q - '0');
+                digits += mantissa != 0;
+            }
+            else
+                exponent++;
+        }
+        if (q < end && *q == '.')
+        {
+            for (q++; q < end && is_digit(*q); q++, any = true)
+            {
+                if (digits < 17)
+                {
+                    mantissa = mantissa * 10 + uint64_t(*q - '0');
+                    digits += mantissa != 0;
+                    exponent--;
+                }
+            }
+        }
+        if (!any)
+            return false;
+
+        if (q < end && (*q == 'e' || *q == 'E'))
+        {
+            const char *e = q + 1;
+            bool negative_exponent = false;
+            if (e < end && (*e == '-' || *e == '+'))
+                negative_exponent = *e++ == '-';
+            if (e < end && is_digit(*e))
+            {
+                int value = 0;
+                for (; e < end && is_digit(*e); e++)
+                    value = std::min(value * 10 + (*e - '0'), 10000);
+                exponent += negative_exponent ? -value : value;
+                q = e;
+            }
+        }
+
+        double value = double(mantissa);
+        if (exponent >= 0)
+            value *= exponent <= 22 ? powers[exponent] : std::pow(10.0, exponent);
+        else
+            value = exponent >= -22 ? value / powers[-exponent] : value * std::pow(10.0, exponent);
+        out = negative ? -value : value;
+        p = q;
+        return true;
+    }
+
+    inline bool parse_int(const char *&p, const char *end, long long &out)
+    {
+        const char *q = p;
+        bool negative = false;
+        if (q < end && (*q == '-' || *q == '+'))
+            negative = *q++ == '-';
+        if (q >= end || !is_digit(*q))
+            return false;
+        long long value = 0;
+        for (; q < end && is_digit(*q); q++)
+            value = std::min(value * 10 + (*q - '0'), 0xffffffffLL);
+        out = negative ? -value : value;
+        p = q;
+        return true;
+    }
+
+    // 1 起的绝对索引或负的相对索引 -> 0 起的索引；seen 是到这一行为止读到的数量。无效时返回越界值
+    inline uint32_t resolve_index(long long index, size_t seen)
+    {
+        long long resolved = index > 0 ? index - 1 : (long long)seen + index;
+        return index != 0 && resolved >= 0 && resolved < 0xffffffffLL ? uint32_t(resolved) : 0xffffffffu;
+    }
+
+    struct obj_counts
+    {
+        size_t positions = 0, normals = 0, uvs = 0;
+    };
+
+    // Classifies an OBJ line by its keyword: 'v' position, 'n' normal, 't' texture, 'f' face.
+    inline char obj_keyword(const char *&p, const char *end)
+    {
+        p = skip_blanks(p, end);
+        if (end - p < 2)
+            return 0;
+        char kind = 0;
+        if (p[0] == 'v')
+        {
+            if (is_blank(p[1]))
+                kind = 'v';
+            else if ((p[1] == 'n' || p[1] == 't') && end - p > 2 && is_blank(p[2]))
+                kind = p[1];
+        }
+        else if (p[0] == 'f' && is_blank(p[1]))
+            kind = 'f';
+        p += kind == 'n' || kind == 't' ? 2 : kind ? 1 : 0;
+        return kind;
+    }
+
+    struct obj_block
+    {
+        const char *begin = nullptr, *end = nullptr;
+        obj_counts first; // 本块之前的数量
+        obj_counts count;
+        std::vector<uint32_t> positions, uvs, normals; // 三角形的索引
+        bool missing_uvs = false, missing_normals = false;
+    };
+
+    inline void count_obj_block(obj_block &block)
+    {
+        for (const char *p = block.begin; p < block.end; p = next_line(p, block.end))
+        {
+            const char *q = p;
+            switch (obj_keyword(q, block.end))
+            {
+            case 'v': block.count.positions++; break;
+            case 'n': block.count.normals++; break;
+            case 't': block.count.uvs++; break;
+            default:;
+            }
+        }
+    }
+
+    inline void parse_obj_block(obj_block &block, mesh_data &mesh)
+    {
+        obj_counts seen = block.first;
+        std::vector<uint32_t> corner_p, corner_t, corner_n;
+        for (const char *p = block.begin, *line_end; p < block.end; p = line_end)
+        {
+            line_end = next_line(p, block.end);
+            const char *q = p;
+            char kind = obj_keyword(q, line_end);
+            if (kind == 'v' || kind == 'n' || kind == 't')
+            {
+                int components = kind == 't' ? 2 : 3;
+                float *out = kind == 'v' ? &mesh.positions[seen.positions++ * 3]
+                           : kind == 'n' ? &mesh.normals[seen.normals++ * 3]
+                                         : &mesh.uvs[seen.uvs++ * 2];
+                for (int c = 0; c < components; c++)
+                {
+                    double value = 0;
+                    parse_double(q, line_end, value);
+                    out[c] = float(value);
+                }
+            }
+            else if (kind == 'f')
+            {
+                corner_p.clear();
+                corner_t.clear();
+                corner_n.clear();
+                while (true)
+                {
+                    long long index;
+                    q = skip_blanks(q, line_end);
+                    if (!parse_int(q, line_end, index))
+                        break;
+                    corner_p.push_back(resolve_index(index, seen.positions));
+                    bool has_t = false, has_n = false;
+                    if (q < line_end && *q == '/')
+                    {
+                        q++;
+                        if (parse_int(q, line_end, index))
+                        {
+                            corner_t.push_back(resolve_index(index, seen.uvs));
+                            has_t = true;
+                        }
+                        if (q < line_end && *q == '/')
+                        {
+                            q++;
+                            if (parse_int(q, line_end, index))
+                            {
+                                corner_n.push_back(resolve_index(index, seen.normals));
+                                has_n = true;
+                            }
+                        }
+                    }
+                    if (!has_t)
+                        corner_t.push_back(0);
+                    if (!has_n)
+                        corner_n.push_back(0);
+                    block.missing_uvs = block.missing_uvs || !has_t;
+                    block.missing_normals = block.missing_normals || !has_n;
+                    // Skip anything else glued to this corner.
+                    while (q < line_end && !is_blank(*q) && *q != '\n')
+                        q++;
+                }
+
+                for (size_t k = 1; k + 1 < corner_p.size(); k++)
+                {
+                    size_t fan[3] = {0, k, k + 1};
+                    for (size_t c : fan)
+                    {
+                        block.positions.push_back(corner_p[c]);
+                        block.uvs.push_back(corner_t[c]);
+                        block.normals.push_back(corner_n[c]);
+                    }
+                }
+            }
+        }
+    }
+
+    // 与顶点一一对应的属性不需要单独的索引
+    inline void share_position_indices(std::vector<uint32_t> &indices, const std::vector<uint32_t> &positions, bool per_vertex)
+    {
+        if (per_vertex && indices == positions)
+            std::vector<uint32_t>().swap(indices);
+    }
+
+    enum ply_type { ply_int8, ply_uint8, ply_int16, ply_uint16, ply_int32, ply_uint32, ply_float32, ply_float64, ply_invalid };
+
+    inline ply_type ply_type_from_name(const std::string &name)
+    {
+        static const char *names[][2] = {{"char", "int8"}, {"uchar", "uint8"}, {"short", "int16"}, {"ushort", "uint16"},
+                                         {"int", "int32"}, {"uint", "uint32"}, {"float", "float32"}, {"double", "float64"}};
+        for (int t = 0; t < ply_invalid; t++)
+            if (name == names[t][0] || name == names[t][1])
+                return ply_type(t);
+        return ply_invalid;
+    }
+
+    inline size_t ply_type_size(ply_type type)
+    {
+        static const size_t sizes[] = {1, 1, 2, 2, 4, 4, 4, 8, 0};
+        return sizes[type];
+    }
+
+    inline double ply_read(const char *p, ply_type type, bool swap)
+    {
+        unsigned char bytes[8];
+        size_t size = ply_type_size(type);
+        std::memcpy(bytes, p, size);
+        if (swap)
+            std::reverse(bytes, bytes + size);
+        switch (type)
+        {
+        case ply_int8: { int8_t v; std::memcpy(&v, bytes, 1); return v; }
+        case ply_uint8: return bytes[0];
+        case ply_int16: { int16_t v; std::memcpy(&v, bytes, 2); return v; }
+        case ply_uint16: { uint16_t v; std::memcpy(&v, bytes, 2); return v; }
+        case ply_int32: { int32_t v; std::memcpy(&v, bytes, 4); return v; }
+        case ply_uint32: { uint32_t v; std::memcpy(&v, bytes, 4); return v; }
+        case ply_float32: { float v; std::memcpy(&v, bytes, 4); return v; }
+        case ply_float64: { double v; std::memcpy(&v, bytes, 8); return v; }
+        default: return 0;
+        }
+    }
+
+    // 负的索引变成越界值，由 triangle_mesh 丢弃
+    inline uint32_t ply_index(const char *p, ply_type type, bool swap)
+    {
+        double index = ply_read(p, type, swap);
+        return index >= 0 && index < 4294967295.0 ? uint32_t(index) : 0xffffffffu;
+    }
+
+    struct ply_property
+    {
+        std::string name;
+        ply_type type = ply_invalid;
+        ply_type count_type = ply_invalid; // 列表属性的长度类型
+        bool is_list = false;
+        size_t offset = 0;                 // 定长元素中的字节偏移
+    };
+
+    struct ply_element
+    {
+        std::string name;
+        size_t count = 0;
+        std::vector<ply_property> properties;
+        size_t stride = 0; // 定长元素的字节数；含列表时为 0
+
+        const ply_property *find(std::initializer_list<const char *> names) const
+        {
+            for (const char *name : names)
+                for (const auto &property : properties)
+                    if (property.name == name)
+                        return &property;
+            return nullptr;
+        }
+    };
+
+    // 跳过一个变长元素的一项；越界时返回 nullptr
+    inline const char *ply_skip_item(const char *p, const char *end, const ply_element &element, bool swap)
+    {
+        for (const auto &property : element.properties)
+        {
+            if (property.is_list)
+            {
+                if (p + ply_type_size(property.count_type) > end)
+                    return nullptr;
+                double n = ply_read(p, property.count_type, swap);
+                p += ply_type_size(property.count_type);
+                if (n < 0 || double(end - p) < n * ply_type_size(property.type))
+                    return nullptr;
+                p += size_t(n) * ply_type_size(property.type);
+            }
+            else
+            {
+                p += ply_type_size(property.type);
+                if (p > end)
+                    return nullptr;
+            }
+        }
+        return p;
+    }
+
+    inline bool fail(const std::string &path, const std::string &message)
+    {
+        std::cerr << "ERROR: Could not load mesh file '" << path << "': " << message << ".\n";
+        return false;
+    }
+}
+
+// 读取 OBJ 文件中的三角形；忽略材质、分组和平滑组
+inline bool load_obj(const std::string &path, mesh_data &mesh, int thread_count = 0)
+{
+    using namespace mesh_parse;
+
+    mapped_file file(path);
+    if (!file.is_open())
+        return fail(path, "cannot open file");
+
+    // Block boundaries fall just after a newline, so no line is split between two blocks.
+    std::vector<obj_block> blocks;
+    for (const char *p = file.begin(); p < file.end();)
+    {
+        obj_block block;
+        block.begin = p;
+        block.end = size_t(file.end() - p) > obj_block_size ? next_line(p + obj_block_size, file.end()) : file.end();
+        p = block.end;
+        blocks.push_back(std::move(block));
+    }
+
+    thread_pool pool(thread_count);
+    pool.parallel_for(int(blocks.size()), [&](int item, int) { count_obj_block(blocks[item]); });
+
+    obj_counts total;
+    for (auto &block : blocks)
+    {
+        block.first = total;
+        total.positions += block.count.positions;
+        total.normals += block.count.normals;
+        total.uvs += block.count.uvs;
+    }
+    mesh = mesh_data();
+    mesh.positions.resize(total.positions * 3);
+    mesh.normals.resize(total.normals * 3);
+    mesh.uvs.resize(total.uvs * 2);
+
+    pool.parallel_for(int(blocks.size()), [&](int item, int) { parse_obj_block(blocks[item], mesh); });
+
+    // Concatenate the blocks' triangles. An attribute is kept only if every corner names it.
+    std::vector<size_t> first_index(blocks.size() + 1, 0);
+    bool has_uvs = total.uvs > 0, has_normals = total.normals > 0;
+    for (size_t b = 0; b < blocks.size(); b++)
+    {
+        first_index[b + 1] = first_index[b] + blocks[b].positions.size();
+        has_uvs = has_uvs && !blocks[b].missing_uvs;
+        has_normals = has_normals && !blocks[b].missing_normals;
+    }
+    size_t index_count = first_index.back();
+    mesh.position_indices.resize(index_count);
+    mesh.uv_indices.resize(has_uvs ? index_count : 0);
+    mesh.normal_indices.resize(has_normals ? index_count : 0);
+    pool.parallel_for(int(blocks.size()), [&](int item, int)
+    {
+        obj_block &block = blocks[item];
+        std::copy(block.positions.begin(), block.positions.end(), mesh.position_indices.begin() + first_index[item]);
+        if (has_uvs)
+            std::copy(block.uvs.begin(), block.uvs.end(), mesh.uv_indices.begin() + first_index[item]);
+        if (has_normals)
+            std::copy(block.normals.begin(), block.normals.end(), mesh.normal_indices.begin() + first_index[item]);
+        std::vector<uint32_t>().swap(block.positions);
+        std::vector<uint32_t>().swap(block.uvs);
+        std::vector<uint32_t>().swap(block.normals);
+    });
+
+    if (!has_uvs)
+        std::vector<float>().swap(mesh.uvs);
+    if (!has_normals)
+        std::vector<float>().swap(mesh.normals);
+    share_position_indices(mesh.uv_indices, mesh.position_indices, mesh.uvs.size() / 2 == mesh.vertex_count());
+    share_position_indices(mesh.normal_indices, mesh.position_indices, mesh.normals.size() == mesh.positions.size());
+    return true;
+}
+
+// 读取二进制 PLY 文件中的 vertex 和 face 元素（大端或小端）；其他元素被跳过
+inline bool load_ply(const std::string &path, mesh_data &mesh, int thread_count = 0)
+{
+    using namespace mesh_parse;
+
+    mapped_file file(path);
+    if (!file.is_open())
+        return fail(path, "cannot open file");
+
+    // 文件头
+    const char *p = file.begin();
+    std::vector<ply_element> elements;
+    std::string format;
+    bool first_line = true, header_done = false;
+    while (p < file.end() && !header_done)
+    {
+        const char *line_end = next_line(p, file.end());
+        std::istringstream line(std::string(p, line_end));
+        p = line_end;
+
+        std::string keyword;
+        line >> keyword;
+        if (first_line)
+        {
+            if (keyword != "ply")
+                return fail(path, "not a PLY file");
+            first_line = false;
+        }
+        else if (keyword == "format")
+            line >> format;
+        else if (keyword == "element")
+        {
+            ply_element element;
+            line >> element.name >> element.count;
+            elements.push_back(element);
+        }
+        else if (keyword == "property")
+        {
+            if (elements.empty())
+                return fail(path, "property outside an element");
+            ply_property property;
+            std::string type;
+            line >> type;
+            if (type == "list")
+            {
+                std::string count_type;
+                line >> count_type >> type;
+                property.is_list = true;
+                property.count_type = ply_type_from_name(count_type);
+                if (property.count_type == ply_invalid)
+                    return fail(path, "unknown property type '" + count_type + "'");
+            }
+            property.type = ply_type_from_name(type);
+            if (property.type == ply_invalid)
+                return fail(path, "unknown property type '" + type + "'");
+            line >> property.name;
+            elements.back().properties.push_back(property);
+        }
+        else if (keyword == "end_header")
+            header_done = true;
+    }
+    if (!header_done)
+        return fail(path, "missing end_header");
+    if (format != "binary_little_endian" && format != "binary_big_endian")
+        return fail(path, "only binary PLY files are supported");
+
+    const uint16_t probe = 1;
+    bool host_big_endian = *reinterpret_cast<const unsigned char *>(&probe) == 0;
+    bool swap = (format == "binary_big_endian") != host_big_endian;
+
+    for (auto &element : elements)
+    {
+        size_t offset = 0;
+        bool fixed = true;
+        for (auto &property : element.properties)
+        {
+            property.offset = offset;
+            offset += ply_type_size(property.type);
+            fixed = fixed && !property.is_list;
+        }
+        element.stride = fixed ? offset : 0;
+    }
+
+    mesh = mesh_data();
+    thread_pool pool(thread_count);
+    bool have_vertices = false;
+    for (const auto &element : elements)
+    {
+        size_t blocks = (element.count + ply_block_items - 1) / ply_block_items;
+
+        if (element.name == "vertex")
+        {
+            if (element.stride == 0)
+                return fail(path, "vertex element with list properties");
+            if (double(file.end() - p) < double(element.count) * element.stride)
+                return fail(path, "file is truncated");
+
+            const ply_property *x = element.find({"x"}), *y = element.find({"y"}), *z = element.find({"z"});
+            const ply_property *nx = element.find({"nx"}), *ny = element.find({"ny"}), *nz = element.find({"nz"});
+            const ply_property *u = element.find({"u", "s", "texture_u", "texture_s"});
+            const ply_property *v = element.find({"v", "t", "texture_v", "texture_t"});
+            if (!x || !y || !z)
+                return fail(path, "vertices have no position");
+            bool has_normals = nx && ny && nz, has_uvs = u && v;
+
+            mesh.positions.resize(element.count * 3);
+            mesh.normals.resize(has_normals ? element.count * 3 : 0);
+            mesh.uvs.resize(has_uvs ? element.count * 2 : 0);
+            const char *data = p;
+            pool.parallel_for(int(blocks), [&](int item, int)
+            {
+                size_t last = std::min(element.count, (size_t(item) + 1) * ply_block_items);
+                for (size_t i = size_t(item) * ply_block_items; i < last; i++)
+                {
+                    const char *vertex = data + i * element.stride;
+                    const ply_property *position[3] = {x, y, z}, *normal[3] = {nx, ny, nz};
+                    for (int c = 0; c < 3; c++)
+                        mesh.positions[i * 3 + c] = float(ply_read(vertex + position[c]->offset, position[c]->type, swap));
+                    if (has_normals)
+                        for (int c = 0; c < 3; c++)
+                            mesh.normals[i * 3 + c] = float(ply_read(vertex + normal[c]->offset, normal[c]->type, swap));
+                    if (has_uvs)
+                    {
+                        mesh.uvs[i * 2] = float(ply_read(vertex + u->offset, u->type, swap));
+                        mesh.uvs[i * 2 + 1] = float(ply_read(vertex + v->offset, v->type, swap));
+                    }
+                }
+            });
+            p += element.count * element.stride;
+            have_vertices = true;
+        }
+        else if (element.name == "face")
+        {
+            const ply_property *indices = element.find({"vertex_indices", "vertex_index"});
+            if (!indices || !indices->is_list)
+                return fail(path, "faces have no vertex_indices list");
+
+            // Sequential walk: where each block of faces starts and how many triangles precede it.
+            std::vector<const char *> block_start(blocks + 1);
+            std::vector<size_t> first_triangle(blocks + 1);
+            size_t triangles = 0;
+            for (size_t f = 0; f < element.count; f++)
+            {
+                if (f % ply_block_items == 0)
+                {
+                    block_start[f / ply_block_items] = p;
+                    first_triangle[f / ply_block_items] = triangles;
+                }
+                // ply_skip_item checks the whole face lies in the file before its properties are read
+                const char *face = p;
+                p = ply_skip_item(p, file.end(), element, swap);
+                if (!p)
+                    return fail(path, "file is truncated");
+                for (const auto &property : element.properties)
+                {
+                    if (!property.is_list)
+                    {
+                        face += ply_type_size(property.type);
+                        continue;
+                    }
+                    size_t n = size_t(ply_read(face, property.count_type, swap));
+                    face += ply_type_size(property.count_type);
+                    if (&property == indices)
+                    {
+                        triangles += n > 2 ? n - 2 : 0;
+                        break;
+                    }
+                    face += n * ply_type_size(property.type);
+                }
+            }
+            block_start[blocks] = p;
+            first_triangle[blocks] = triangles;
+
+            // The list is not necessarily the first property, so each face is walked again.
+            mesh.position_indices.resize(triangles * 3);
+            std::vector<char> block_ok(blocks, 1);
+            pool.parallel_for(int(blocks), [&](int item, int)
+            {
+                const char *face = block_start[item];
+                uint32_t *out = mesh.position_indices.data() + first_triangle[item] * 3;
+                uint32_t *block_end = mesh.position_indices.data() + first_triangle[item + 1] * 3;
+                size_t last = std::min(element.count, (size_t(item) + 1) * ply_block_items);
+                for (size_t f = size_t(item) * ply_block_items; f < last; f++)
+                {
+                    for (const auto &property : element.properties)
+                    {
+                        size_t item_size = ply_type_size(property.type);
+                        if (!property.is_list)
+                        {
+                            face += item_size;
+                            continue;
+                        }
+                        size_t n = size_t(ply_read(face, property.count_type, swap));
+                        face += ply_type_size(property.count_type);
+                        if (&property == indices)
+                        {
+                            uint32_t first = ply_index(face, property.type, swap);
+                            for (size_t k = 1; k + 1 < n; k++)
+                            {
+                                if (out == block_end)
+                                {
+                                    block_ok[item] = 0;
+                                    return;
+                                }
+                                *out++ = first;
+                                *out++ = ply_index(face + k * item_size, property.type, swap);
+                                *out++ = ply_index(face + (k + 1) * item_size, property.type, swap);
+                            }
+                        }
+                        face += n * item_size;
+                    }
+                }
+                block_ok[item] = out == block_end;
+            });
+            if (std::find(block_ok.begin(), block_ok.end(), 0) != block_ok.end())
+                return fail(path, "face lists are inconsistent");
+        }
+        else if (element.stride > 0)
+        {
+            if (double(file.end() - p) < double(element.count) * element.stride)
+                return fail(path, "file is truncated");
+            p += element.count * element.stride;
+        }
+        else
+        {
+            for (size_t i = 0; i < element.count && p; i++)
+                p = ply_skip_item(p, file.end(), element, swap);
+            if (!p)
+                return fail(path, "file is truncated");
+        }
+    }
+
+    if (!have_vertices)
+        return fail(path, "no vertex element");
+    return true;
+}
+
+// 按扩展名选择 OBJ 或 PLY
+inline bool load_mesh(const std::string &path, mesh_data &mesh, int thread_count = 0)
+{
+    std::string extension = path.substr(std::min(path.size(), path.find_last_of('.')));
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return char(std::tolower(c)); });
+    if (extension == ".obj")
+        return load_obj(path, mesh, thread_count);
+    if (extension == ".ply")
+        return load_ply(path, mesh, thread_count);
+    return mesh_parse::fail(path, "unknown mesh format");
+}
+
+// 带缓存的读取
+// The cache sits next to the model as <path>.rtcache and is keyed by a hash of the model file's
+// bytes and the BVH options, so changing either rebuilds it; an unchanged model is used straight
+// from the mapped cache without parsing or building. Returns nullptr if the model cannot be loaded.
+inline shared_ptr<triangle_mesh> load_mesh_cached(const std::string &path, shared_ptr<material> mat,
+                                                  const bvh_build_options &options = bvh_build_options())
+{
+    uint64_t key;
+    {
+        mapped_file source(path);
+        if (!source.is_open())
+        {
+            mesh_parse::fail(path, "cannot open file");
+            return nullptr;
+        }
+        content_hasher hasher;
+        hasher.add(source.data(), source.size());
+        hasher.add_options(options);
+        key = hasher.value();
+    }
+
+    std::string cache_path = path + ".rtcache";
+    if (auto mesh = triangle_mesh::load_cache(cache_path, key, mat))
+        return mesh;
+
+    mesh_data data;
+    if (!load_mesh(path, data))
+        return nullptr;
+    auto mesh = make_shared<triangle_mesh>(std::move(data), mat, options);
+    if (!mesh->save_cache(cache_path, key))
+        std::cerr << "WARNING: Could not write mesh cache '" << cache_path << "'.\n";
+    return mesh;
+}
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef PIXEL_ESTIMATE_H
+#define PIXEL_ESTIMATE_H
+
+#include "rtweekend.h"
+
+// 像素的采样统计
+// Running sum of a pixel's samples plus Welford's mean and variance of their luminance, which
+// adaptive sampling uses to decide when the pixel has converged.
+class pixel_estimate
+{
+public:
+    color sum = color(0, 0, 0);
+    int count = 0;
+
+    pixel_estimate() {}
+    pixel_estimate(const color &sum, int count, double mean, double m2)
+        : sum(sum), count(count), mean(mean), m2(m2) {}
+
+    void add(const color &sample)
+    {
+        sum += sample;
+        count++;
+
+        double y = luminance(sample);
+        double delta = y - mean;
+        mean += delta / count;
+        m2 += delta * (y - mean);
+    }
+
+    color value() const { return count > 0 ? sum * (1.0 / count) : color(0, 0, 0); }
+
+    // Standard error of the mean luminance after gamma 2 encoding (d sqrt(y) = dy / 2 sqrt(y)),
+    // so the threshold is in displayed units and dark pixels are not oversampled relative to
+    // bright ones.
+    double display_error() const
+    {
+        if (count < 2)
+            return infinity;
+        return std::sqrt(mean_variance()) / (2.0 * std::sqrt(std::max(mean, 1e-4)));
+    }
+
+    // Variance of the mean luminance (the squared standard error), infinity below two samples.
+    double mean_variance() const
+    {
+        if (count < 2)
+            return infinity;
+        return m2 / (count - 1) / count;
+    }
+
+    double luminance_mean() const { return mean; }
+    double luminance_m2() const { return m2; }
+
+private:
+    double mean = 0;
+    double m2 = 0;
+};
+
+#endif
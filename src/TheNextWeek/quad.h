@@ -4,6 +4,7 @@
 #include "rtweekend.h"
 #include "hittable_list.h"
 #include "hittable.h"
+#include "material.h"
 
 class quad : public hittable
 {
@@ -15,6 +16,9 @@ public:
         normal = unit_vector(n);
         D = dot(normal, Q);
         w = n / dot(n, n);
+        area = n.length();
+
+        set_bounding_box();
     }
     virtual void set_bounding_box()
     {
@@ -29,14 +33,17 @@ public:
 
     bool hit(const ray &r, interval ray_t, hit_record &rec) const override
     {
+        RT_STAT(thread_stats().primitive_tests++);
         auto denom = dot(normal, r.direction());
         // No hit if the ray is parallel to the plane.
-        if (std::fabs(denom) < 1e-8)
+        if (std::fabs(denom) < real(1e-8))
             return false;
 
-        // Return false if the hit point parameter t is outside the ray interval.
+        // Return false if the hit point parameter t is outside the ray interval. The test is
+        // strict: a spawned ray's origin sits just off the plane, and t for it can underflow to
+        // -0, which must not count as a hit at t_min = 0.
         auto t = (D - dot(normal, r.origin())) / denom;
-        if (!ray_t.contains(t))
+        if (!ray_t.surrounds(t))
             return false;
 
         // Determine if the hit point lies within the planar shape using its plane coordinates.
@@ -49,14 +56,91 @@ public:
             return false;
 
         // hit the quad
-        rec.t = t;
-        // bug fix: auto p -> rec.p
-        rec.p = intersection;
-        rec.mat_ptr = mat;
-        rec.set_face_normal(r, normal);
+        set_hit_record(r, t, alpha, beta, rec);
         return true;
     }
 
+    // 按面积均匀采样，换算成立体角密度：pdf = distance^2 / (|cos| * area)
+    double pdf_value(const point3 &origin, const vec3 &direction) const override
+    {
+        hit_record rec;
+        if (!this->hit(ray(origin, direction), interval(0, infinity), rec))
+            return 0;
+
+        auto distance_squared = rec.t * rec.t * direction.length_squared();
+        auto cosine = std::fabs(dot(direction, rec.normal) / direction.length());
+        return distance_squared / (cosine * area);
+    }
+
+    vec3 random(const point3 &origin) const override
+    {
+        auto p = Q + (random_double() * u) + (random_double() * v);
+        return p - origin;
+    }
+
+    void collect_emitters(std::vector<const hittable *> &emitters) const override
+    {
+        if (mat->is_emissive())
+            emitters.push_back(this);
+    }
+
+    // 功率按中心处的亮度估计；diffuse_light 双面发光
+    light_bounds emitter_bounds() const override
+    {
+        light_bounds lb;
+        color L = mat->emitted(0.5, 0.5, Q + 0.5 * (u + v));
+        lb.bounds = bbox;
+        lb.phi = 2 * pi * area * luminance(L);
+        lb.axis = normal;
+        lb.cos_theta_o = 1;
+        lb.cos_theta_e = 0;
+        lb.two_sided = true;
+        return lb;
+    }
+
+    // 光线包求交：平面求交和平面坐标按通道以 SoA 方式计算，内部判定仍交给 is_interior()
+    void hit_packet(ray_packet &packet, unsigned lanes, packet_hit &hits) const override
+    {
+        RT_STAT(thread_stats().primitive_tests += lane_count(lanes));
+        const int n = ray_packet::max_size;
+        real ts[n], alphas[n], betas[n];
+        int candidate[n];
+
+        for (int k = 0; k < n; k++)
+        {
+            real denom = normal.x() * packet.dir_x[k] + normal.y() * packet.dir_y[k] + normal.z() * packet.dir_z[k];
+            real t = (D - (normal.x() * packet.org_x[k] + normal.y() * packet.org_y[k] + normal.z() * packet.org_z[k])) / denom;
+
+            real px = packet.org_x[k] + t * packet.dir_x[k] - Q.x();
+            real py = packet.org_y[k] + t * packet.dir_y[k] - Q.y();
+            real pz = packet.org_z[k] + t * packet.dir_z[k] - Q.z();
+
+            // alpha = dot(w, cross(p, v)), beta = dot(w, cross(u, p))
+            real alpha = w.x() * (py * v.z() - pz * v.y()) + w.y() * (pz * v.x() - px * v.z()) + w.z() * (px * v.y() - py * v.x());
+            real beta = w.x() * (u.y() * pz - u.z() * py) + w.y() * (u.z() * px - u.x() * pz) + w.z() * (u.x() * py - u.y() * px);
+
+            ts[k] = t;
+            alphas[k] = alpha;
+            betas[k] = beta;
+            candidate[k] = (std::fabs(denom) >= real(1e-8)) & (packet.t_min < t) & (t < packet.t_max[k]);
+        }
+
+        for (; lanes; lanes &= lanes - 1)
+        {
+            int k = lowest_lane(lanes);
+            if (!candidate[k])
+                continue;
+
+            hit_record &rec = hits.rec[k];
+            if (!is_interior(alphas[k], betas[k], rec))
+                continue;
+
+            set_hit_record(packet.rays[k], ts[k], alphas[k], betas[k], rec);
+            packet.t_max[k] = ts[k];
+            hits.mask |= 1u << k;
+        }
+    }
+
     virtual bool is_interior(double a, double b, hit_record &rec) const
     {
         // Check if the hit point is inside the planar shape.
@@ -79,7 +163,21 @@ private:
     shared_ptr<material> mat;
     aabb bbox;
     vec3 normal;
-    double D;
+    real D;
+    double area;
+
+    // The hit point is rebuilt from its plane coordinates so it lies on the quad up to the
+    // rounding of Q + alpha u + beta v, instead of carrying the error of t as r.at(t) would.
+    void set_hit_record(const ray &r, real t, real alpha, real beta, hit_record &rec) const
+    {
+        vec3 along_u = alpha * u, along_v = beta * v;
+        rec.t = t;
+        rec.p = Q + along_u + along_v;
+        rec.p_error = error_gamma(7) * (abs(Q) + abs(along_u) + abs(along_v));
+        rec.mat_ptr = mat.get();
+        rec.object = this;
+        rec.set_face_normal(r, normal);
+    }
 };
 
 inline shared_ptr<hittable_list> box(const point3 &a, const point3 &b, shared_ptr<material> mat)
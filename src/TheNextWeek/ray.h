@@ -3,25 +3,29 @@
 
 #include "vec3.h"
 
-class ray
+// 光线，按标量类型 T 模板化；时间 tm 是运动模糊的采样时刻，始终是 double
+template <typename T>
+class basic_ray
 {
 public:
-    ray() {}
+    basic_ray() {}
     // 传值
-    ray(const point3 &origin, const vec3 &direction) : orig(origin), dir(direction), tm(0) {}
-    ray(const point3 &origin, const vec3 &direction, double time) : orig(origin), dir(direction), tm(time) {}
+    basic_ray(const basic_vec3<T> &origin, const basic_vec3<T> &direction) : orig(origin), dir(direction), tm(0) {}
+    basic_ray(const basic_vec3<T> &origin, const basic_vec3<T> &direction, double time) : orig(origin), dir(direction), tm(time) {}
 
-    const point3 &origin() const { return orig; }
-    const vec3 &direction() const { return dir; }
+    const basic_vec3<T> &origin() const { return orig; }
+    const basic_vec3<T> &direction() const { return dir; }
 
     double get_time() const { return tm; }
 
-    point3 at(double t) const { return orig + t * dir; }
+    basic_vec3<T> at(T t) const { return orig + t * dir; }
 
 private:
-    point3 orig;
-    vec3 dir;
+    basic_vec3<T> orig;
+    basic_vec3<T> dir;
     double tm;
 };
 
-#endif
\ No newline at end of file
+typedef basic_ray<real> ray;
+
+#endif
@@ -0,0 +1,86 @@
+#ifndef RAY_PACKET_H
+#define RAY_PACKET_H
+
+#include "rtweekend.h"
+
+// 光线包
+// Up to max_size coherent rays in structure-of-arrays form, traced together so they share node
+// fetches and let the intersectors run one lane per SIMD element. t_max holds each lane's
+// closest hit so far and shrinks as hits are found. The AoS copy in rays[] feeds the scalar
+// fallbacks.
+class ray_packet
+{
+public:
+    static const int max_size = 8;
+
+    int size = 0;
+    real t_min = 0;
+    real org_x[max_size], org_y[max_size], org_z[max_size];
+    real dir_x[max_size], dir_y[max_size], dir_z[max_size];
+    real inv_x[max_size], inv_y[max_size], inv_z[max_size];
+    double time[max_size];
+    real t_max[max_size];
+    ray rays[max_size];
+
+    // Lanes that were never set hold empty rays with t_max = 0, so the SoA loops, which always
+    // run over every lane, read defined values and never report a hit for them.
+    ray_packet()
+    {
+        for (int k = 0; k < max_size; k++)
+        {
+            org_x[k] = org_y[k] = org_z[k] = 0;
+            dir_x[k] = dir_y[k] = dir_z[k] = 0;
+            inv_x[k] = inv_y[k] = inv_z[k] = 0;
+            time[k] = 0;
+            t_max[k] = 0;
+        }
+    }
+
+    void set(int lane, const ray &r, interval ray_t)
+    {
+        rays[lane] = r;
+        org_x[lane] = r.origin().x();
+        org_y[lane] = r.origin().y();
+        org_z[lane] = r.origin().z();
+        dir_x[lane] = r.direction().x();
+        dir_y[lane] = r.direction().y();
+        dir_z[lane] = r.direction().z();
+        inv_x[lane] = 1 / dir_x[lane];
+        inv_y[lane] = 1 / dir_y[lane];
+        inv_z[lane] = 1 / dir_z[lane];
+        time[lane] = r.get_time();
+        t_min = ray_t.min;
+        t_max[lane] = ray_t.max;
+    }
+
+    unsigned full_mask() const { return (1u << size) - 1; }
+};
+
+// Packets pay off once a packet's lanes fill a few wide vector registers. With SSE2 alone the
+// single-ray early-outs are faster, so camera only enables packet tracing by default on AVX builds.
+#if defined(__AVX__)
+const bool packet_tracing_default = true;
+#else
+const bool packet_tracing_default = false;
+#endif
+
+inline int lane_count(unsigned mask)
+{
+    int n = 0;
+    for (; mask; mask &= mask - 1)
+        n++;
+    return n;
+}
+
+inline int lowest_lane(unsigned mask)
+{
+    int lane = 0;
+    while (!(mask & 1u))
+    {
+        mask >>= 1;
+        lane++;
+    }
+    return lane;
+}
+
+#endif
@@ -0,0 +1,360 @@
+#ifndef RENDER_JOB_H
+#define RENDER_JOB_H
+
+#include "rtweekend.h"
+#include "camera.h"
+#include "scenes.h"
+
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// 渲染任务文件
+// A plain text file of `key = value` lines; `#` starts a comment. Each `[job]` line starts a new
+// job, and anything before the first one is a default shared by every job that follows. `scene`
+// names a built-in scene or an .obj/.ply model (see make_scene); every other key is a
+// camera_settings field by name and overrides the scene's default view:
+//
+//     scene = cornell_box
+//     samples_per_pixel = 100
+//
+//     [job]
+//     output_path = front.png
+//
+//     [job]
+//     output_path = close.png
+//     lookfrom = 278 278 -400
+//
+// Vectors and colours are three numbers, aspect_ratio may be written as 16/9, booleans are
+// true/false, and the denoiser's options are denoise_iterations, denoise_sigma_luminance,
+// denoise_normal_power and denoise_sigma_depth. A file with settings but no `[job]` is one job.
+struct render_job
+{
+    std::string scene;
+    std::vector<std::pair<std::string, std::string>> settings; // 按出现顺序应用
+    std::string source;                                       // "文件:行号"，用于报错
+};
+
+namespace job_parse
+{
+    template <typename T>
+    bool read_value(const std::string &text, T &out)
+    {
+        std::istringstream in(text);
+        return (in >> out) && (in >> std::ws).eof();
+    }
+
+    inline bool read_value(const std::string &text, bool &out)
+    {
+        if (text == "true" || text == "on" || text == "yes" || text == "1")
+            out = true;
+        else if (text == "false" || text == "off" || text == "no" || text == "0")
+            out = false;
+        else
+            return false;
+        return true;
+    }
+
+    inline bool read_value(const std::string &text, vec3 &out)
+    {
+        std::istringstream in(text);
+        double x, y, z;
+        if (!(in >> x >> y >> z) || !(in >> std::ws).eof())
+            return false;
+        out = vec3(x, y, z);
+        return true;
+    }
+
+    inline bool read_value(const std::string &text, std::string &out)
+    {
+        out = text;
+        return true;
+    }
+
+    inline bool read_value(const std::string &text, sampler_kind &out)
+    {
+        static const char *names[] = {"independent", "stratified", "halton", "sobol"};
+        for (int k = 0; k < 4; k++)
+        {
+            if (text == names[k])
+            {
+                out = sampler_kind(k);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // "1.5" 或 "16/9"
+    inline bool read_ratio(const std::string &text, double &out)
+    {
+        auto slash = text.find('/');
+        if (slash == std::string::npos)
+            return read_value(text, out);
+        double width, height;
+        if (!read_value(text.substr(0, slash), width) || !read_value(text.substr(slash + 1), height) || height <= 0)
+            return false;
+        out = width / height;
+        return true;
+    }
+
+    inline std::string trim(const std::string &text)
+    {
+        size_t first = text.find_first_not_of(" \t\r");
+        if (first == std::string::npos)
+            return "";
+        size_t last = text.find_last_not_of(" \t\r");
+        return text.substr(first, last - first + 1);
+    }
+
+    typedef std::function<bool(camera_settings &, const std::string &)> setter;
+
+    template <typename T>
+    std::pair<std::string, setter> field(const char *name, T camera_settings::*member)
+    {
+        return std::make_pair(std::string(name), setter([member](camera_settings &cam, const std::string &text)
+        {
+            return read_value(text, cam.*member);
+        }));
+    }
+
+    template <typename T>
+    std::pair<std::string, setter> denoise_field(const char *name, T denoiser_options::*member)
+    {
+        return std::make_pair(std::string(name), setter([member](camera_settings &cam, const std::string &text)
+        {
+            return read_value(text, cam.denoise_options.*member);
+        }));
+    }
+
+    inline const std::map<std::string, setter> &setters()
+    {
+        static const std::map<std::string, setter> table = {
+            std::make_pair(std::string("aspect_ratio"), setter([](camera_settings &cam, const std::string &text)
+            {
+                return read_ratio(text, cam.aspect_ratio);
+            })),
+            field("image_width", &camera_settings::image_width),
+            field("samples_per_pixel", &camera_settings::samples_per_pixel),
+            field("max_depth", &camera_settings::max_depth),
+            field("rr_min_depth", &camera_settings::rr_min_depth),
+            field("light_sampling", &camera_settings::light_sampling),
+            field("use_light_bvh", &camera_settings::use_light_bvh),
+            field("background", &camera_settings::background),
+            field("vfov", &camera_settings::vfov),
+            field("lookfrom", &camera_settings::lookfrom),
+            field("lookat", &camera_settings::lookat),
+            field("vup", &camera_settings::vup),
+            field("thread_count", &camera_settings::thread_count),
+            field("tile_size", &camera_settings::tile_size),
+            field("seed", &camera_settings::seed),
+            field("packet_tracing", &camera_settings::packet_tracing),
+            field("sampler_type", &camera_settings::sampler_type),
+            field("adaptive_sampling", &camera_settings::adaptive_sampling),
+            field("adaptive_threshold", &camera_settings::adaptive_threshold),
+            field("adaptive_min_samples", &camera_settings::adaptive_min_samples),
+            field("adaptive_batch", &camera_settings::adaptive_batch),
+            field("output_path", &camera_settings::output_path),
+            field("pass_samples", &camera_settings::pass_samples),
+            field("preview_path", &camera_settings::preview_path),
+            field("checkpoint_path", &camera_settings::checkpoint_path),
+            field("denoise", &camera_settings::denoise),
+            denoise_field("denoise_iterations", &denoiser_options::iterations),
+            denoise_field("denoise_sigma_luminance", &denoiser_options::sigma_luminance),
+            denoise_field("denoise_normal_power", &denoiser_options::normal_power),
+            denoise_field("denoise_sigma_depth", &denoiser_options::sigma_depth),
+            field("aov_samples", &camera_settings::aov_samples),
+            field("albedo_path", &camera_settings::albedo_path),
+            field("normal_path", &camera_settings::normal_path),
+            field("depth_path", &camera_settings::depth_path),
+            field("stats_path", &camera_settings::stats_path),
+            field("heatmap_time_path", &camera_settings::heatmap_time_path),
+            field("heatmap_nodes_path", &camera_settings::heatmap_nodes_path),
+            field("heatmap_primitives_path", &camera_settings::heatmap_primitives_path),
+        };
+        return table;
+    }
+
+    inline bool fail(const std::string &source, const std::string &message)
+    {
+        std::cerr << "ERROR: " << source << ": " << message << ".\n";
+        return false;
+    }
+}
+
+// 把一项设置写进 cam；键名未知或值无法解析时返回 false，cam 不变
+inline bool apply_setting(camera_settings &cam, const std::string &key, const std::string &value)
+{
+    const auto &table = job_parse::setters();
+    auto entry = table.find(key);
+    if (entry == table.end())
+        return false;
+    camera_settings changed = cam;
+    if (!entry->second(changed, value))
+        return false;
+    cam = changed;
+    return true;
+}
+
+// 读取任务，追加到 jobs。所有设置在读取时就检查过，渲染开始后不会因为写错的一行而中途失败
+inline bool read_jobs(std::istream &in, const std::string &name, std::vector<render_job> &jobs)
+{
+    using job_parse::fail;
+
+    render_job defaults;
+    std::vector<render_job> read;
+    std::string line;
+    for (int number = 1; std::getline(in, line); number++)
+    {
+        std::string source = name + ":" + std::to_string(number);
+        line = job_parse::trim(line.substr(0, line.find('#')));
+        if (line.empty())
+            continue;
+
+        if (line == "[job]")
+        {
+            read.push_back(defaults);
+            read.back().source = source;
+            continue;
+        }
+
+        auto equals = line.find('=');
+        if (equals == std::string::npos)
+            return fail(source, "expected 'key = value' or '[job]'");
+        std::string key = job_parse::trim(line.substr(0, equals));
+        std::string value = job_parse::trim(line.substr(equals + 1));
+
+        render_job &target = read.empty() ? defaults : read.back();
+        if (key == "scene")
+        {
+            target.scene = value;
+            continue;
+        }
+        camera_settings check;
+        if (!job_parse::setters().count(key))
+            return fail(source, "unknown setting '" + key + "'");
+        if (!apply_setting(check, key, value))
+            return fail(source, "invalid value '" + value + "' for " + key);
+        target.settings.push_back(std::make_pair(key, value));
+    }
+
+    if (read.empty() && (!defaults.scene.empty() || !defaults.settings.empty()))
+    {
+        read.push_back(defaults);
+        read.back().source = name;
+    }
+    for (const auto &job : read)
+    {
+        if (job.scene.empty())
+            return fail(job.source, "job has no scene");
+    }
+    jobs.insert(jobs.end(), read.begin(), read.end());
+    return true;
+}
+
+inline bool read_jobs(const std::string &path, std::vector<render_job> &jobs)
+{
+    std::ifstream in(path);
+    if (!in)
+    {
+        std::cerr << "ERROR: Could not read job file '" << path << "'.\n";
+        return false;
+    }
+    return read_jobs(in, path, jobs);
+}
+
+// 依次渲染一批任务
+// Scenes are built the first time a job asks for them and kept, with their acceleration
+// structures, until the last job that uses them has rendered; images loaded for textures stay
+// shared across all scenes. A hundred views of one scene therefore cost one scene build and a
+// hundred renders.
+class job_runner
+{
+public:
+    // 返回成功渲染的任务数
+    int run(const std::vector<render_job> &jobs)
+    {
+        if (!check_outputs(jobs))
+            return 0;
+
+        std::map<std::string, size_t> last_use;
+        for (size_t i = 0; i < jobs.size(); i++)
+            last_use[jobs[i].scene] = i;
+
+        auto start = std::chrono::steady_clock::now();
+        int rendered = 0, built = 0;
+        for (size_t i = 0; i < jobs.size(); i++)
+        {
+            const render_job &job = jobs[i];
+            camera_settings settings;
+            for (const auto &s : job.settings)
+                apply_setting(settings, s.first, s.second);
+            std::clog << "Job " << (i + 1) << '/' << jobs.size() << ": " << job.scene << " -> "
+                      << (settings.output_path.empty() ? "standard output" : settings.output_path) << '\n';
+
+            auto found = scenes.find(job.scene);
+            if (found == scenes.end())
+            {
+                found = scenes.insert(std::make_pair(job.scene, make_scene(job.scene, resources))).first;
+                built += found->second ? 1 : 0;
+            }
+
+            if (found->second)
+            {
+                camera cam(found->second->view);
+                for (const auto &s : job.settings)
+                    apply_setting(cam, s.first, s.second);
+                cam.render(*found->second->world);
+                rendered++;
+            }
+            if (last_use[job.scene] == i)
+                scenes.erase(found);
+        }
+
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::clog << "Rendered " << rendered << " of " << jobs.size() << " jobs (" << built << " scenes built) in "
+                  << seconds << " s\n";
+        return rendered;
+    }
+
+private:
+    scene_resources resources;
+    std::map<std::string, shared_ptr<scene>> scenes; // 构建失败的场景记为空，不再重试
+
+    // 只有一个任务可以写到标准输出，两个任务也不能写同一个文件（包括检查点，否则后一个任务会从前一个的检查点继续）
+    static bool check_outputs(const std::vector<render_job> &jobs)
+    {
+        if (jobs.size() < 2)
+            return true;
+        std::map<std::string, const render_job *> owners;
+        for (const auto &job : jobs)
+        {
+            camera_settings settings;
+            for (const auto &s : job.settings)
+                apply_setting(settings, s.first, s.second);
+            if (settings.output_path.empty())
+                return job_parse::fail(job.source, "every job in a batch needs an output_path");
+
+            const std::string *paths[] = {&settings.output_path, &settings.preview_path, &settings.checkpoint_path,
+                                          &settings.albedo_path, &settings.normal_path, &settings.depth_path,
+                                          &settings.stats_path, &settings.heatmap_time_path,
+                                          &settings.heatmap_nodes_path, &settings.heatmap_primitives_path};
+            for (const std::string *path : paths)
+            {
+                if (path->empty())
+                    continue;
+                auto owner = owners.insert(std::make_pair(*path, &job)).first;
+                if (owner->second != &job)
+                    return job_parse::fail(job.source, "'" + *path + "' is also written by the job at " + owner->second->source);
+            }
+        }
+        return true;
+    }
+};
+
+#endif
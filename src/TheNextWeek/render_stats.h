@@ -0,0 +1,136 @@
+#ifndef RENDER_STATS_H
+#define RENDER_STATS_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+
+// 渲染统计
+// Built only with RT_STATS=1 (the CMake option RT_STATS). Every thread counts into its own
+// render_stats with plain increments, so counting takes no locks and shares no cache lines; the
+// camera merges each thread's counters after every tile and writes the totals as JSON when the
+// render finishes. Without RT_STATS every RT_STAT() statement expands to nothing.
+#ifndef RT_STATS
+#define RT_STATS 0
+#endif
+
+#if RT_STATS
+#define RT_STAT(statement) do { statement; } while (0)
+#else
+#define RT_STAT(statement) do { } while (0)
+#endif
+
+struct render_stats
+{
+    static const int depth_bins = 64;     // 更深的都计入最后一格
+    static const int material_slots = 16; // 更多的材质类型都计入最后一格
+
+    uint64_t rays_by_depth[depth_bins];    // 路径的第 d 段光线，0 为相机光线
+    uint64_t path_lengths[depth_bins + 1]; // 路径结束时共追踪了几段
+    uint64_t shadow_rays;
+    uint64_t node_visits;                  // 访问的 BVH 节点（光线包中每个参与的通道各算一次）
+    uint64_t box_tests;                    // 包围盒的 slab 测试，宽 BVH 每个节点算 Width 个
+    uint64_t primitive_tests;              // 球、四边形、三角形的求交测试
+    uint64_t scatters;                     // material::scatter 产生了散射光线的次数
+    const char *material_names[material_slots];
+    uint64_t material_hits[material_slots];
+    int material_count;
+
+    // No constructor, so the thread_local instance is zero-initialized statically and accessing it
+    // needs no guard; value-initialize other instances (render_stats()) or call clear().
+    void clear() { std::memset(this, 0, sizeof(*this)); }
+
+    void ray(int depth) { rays_by_depth[std::min(depth, depth_bins - 1)]++; }
+    void path(int length) { path_lengths[std::min(length, int(depth_bins))]++; }
+
+    // 名字是材质类的字符串常量，按指针比较；合并时才比较内容
+    void material_hit(const char *name)
+    {
+        int slot = 0;
+        while (slot < material_count && material_names[slot] != name)
+            slot++;
+        if (slot == material_count)
+        {
+            if (material_count == material_slots)
+                slot = material_slots - 1;
+            else
+                material_names[material_count++] = name;
+        }
+        material_hits[slot]++;
+    }
+
+    void merge(const render_stats &other)
+    {
+        for (int d = 0; d < depth_bins; d++)
+            rays_by_depth[d] += other.rays_by_depth[d];
+        for (int d = 0; d <= depth_bins; d++)
+            path_lengths[d] += other.path_lengths[d];
+        shadow_rays += other.shadow_rays;
+        node_visits += other.node_visits;
+        box_tests += other.box_tests;
+        primitive_tests += other.primitive_tests;
+        scatters += other.scatters;
+
+        for (int k = 0; k < other.material_count; k++)
+        {
+            int slot = 0;
+            while (slot < material_count && std::strcmp(material_names[slot], other.material_names[k]) != 0)
+                slot++;
+            if (slot == material_count)
+            {
+                if (material_count == material_slots)
+                    slot = material_slots - 1;
+                else
+                    material_names[material_count++] = other.material_names[k];
+            }
+            material_hits[slot] += other.material_hits[k];
+        }
+    }
+
+    uint64_t path_rays() const
+    {
+        uint64_t total = 0;
+        for (int d = 0; d < depth_bins; d++)
+            total += rays_by_depth[d];
+        return total;
+    }
+
+    void write_json(std::ostream &out) const
+    {
+        uint64_t rays = path_rays() + shadow_rays;
+        double per_ray = rays > 0 ? 1.0 / double(rays) : 0.0;
+
+        out << "{\n  \"rays\": " << rays << ",\n  \"shadow_rays\": " << shadow_rays << ",\n  \"node_visits\": " << node_visits
+            << ",\n  \"box_tests\": " << box_tests << ",\n  \"primitive_tests\": " << primitive_tests
+            << ",\n  \"node_visits_per_ray\": " << node_visits * per_ray << ",\n  \"box_tests_per_ray\": " << box_tests * per_ray
+            << ",\n  \"primitive_tests_per_ray\": " << primitive_tests * per_ray << ",\n  \"scatters\": " << scatters;
+        write_array(out, "rays_by_depth", rays_by_depth, depth_bins);
+        write_array(out, "path_lengths", path_lengths, depth_bins + 1);
+        out << ",\n  \"material_hits\": {";
+        for (int k = 0; k < material_count; k++)
+            out << (k ? ", " : "") << '"' << material_names[k] << "\": " << material_hits[k];
+        out << "}\n}\n";
+    }
+
+private:
+    // 去掉末尾的零
+    static void write_array(std::ostream &out, const char *name, const uint64_t *values, int count)
+    {
+        while (count > 0 && values[count - 1] == 0)
+            count--;
+        out << ",\n  \"" << name << "\": [";
+        for (int k = 0; k < count; k++)
+            out << (k ? ", " : "") << values[k];
+        out << ']';
+    }
+};
+
+// 当前线程的统计
+inline render_stats &thread_stats()
+{
+    static thread_local render_stats stats;
+    return stats;
+}
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef RNG_H
+#define RNG_H
+
+#include <cstdint>
+
+// PCG32 随机数生成器 (O'Neill, "PCG: A Family of Simple Fast Space-Efficient Statistically Good
+// Algorithms for Random Number Generation"). 64 bits of state plus a stream selector; unlike
+// rand() it carries no hidden global state, so every thread can own one without locking.
+class pcg32
+{
+public:
+    static const uint64_t default_stream = 0xda3e39cb94b95bdbULL;
+
+    pcg32() { seed(0x853c49e6748fea9bULL, default_stream); }
+    pcg32(uint64_t initstate, uint64_t initseq) { seed(initstate, initseq); }
+
+    void seed(uint64_t initstate, uint64_t initseq)
+    {
+        state = 0;
+        inc = (initseq << 1u) | 1u;
+        next_uint();
+        state += initstate;
+        next_uint();
+    }
+
+    uint32_t next_uint()
+    {
+        uint64_t oldstate = state;
+        state = oldstate * 6364136223846793005ULL + inc;
+        uint32_t xorshifted = uint32_t(((oldstate >> 18u) ^ oldstate) >> 27u);
+        uint32_t rot = uint32_t(oldstate >> 59u);
+        return (xorshifted >> rot) | (xorshifted << ((32 - rot) & 31));
+    }
+
+    // 返回[0,1)范围内的实数
+    double next_double()
+    {
+        return next_uint() * (1.0 / 4294967296.0);
+    }
+
+private:
+    uint64_t state;
+    uint64_t inc;
+};
+
+// SplitMix64 finalizer: scrambles a key so neighbouring pixels/samples get unrelated seeds.
+inline uint64_t mix_bits(uint64_t v)
+{
+    v ^= v >> 31;
+    v *= 0x7fb5d329728ea185ULL;
+    v ^= v >> 27;
+    v *= 0x81dadef4bc2dd44dULL;
+    v ^= v >> 33;
+    return v;
+}
+
+// 每个线程独立的生成器，random_double() 从这里取值
+inline pcg32 &thread_rng()
+{
+    static thread_local pcg32 rng;
+    return rng;
+}
+
+#endif
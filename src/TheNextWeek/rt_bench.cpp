@@ -0,0 +1,241 @@
+// 内核微基准
+// Times the hot kernels one at a time on fixed inputs: every benchmark reseeds the generator
+// before building its inputs, so runs see identical rays, points and scenes and the printed
+// checksum (a sum over one pass's results) must match from run to run and build to build. Each
+// kernel runs several trials of at least --min-time / trials seconds; the fastest trial is
+// reported, which is the most repeatable number on a busy machine.
+//
+// 用法：rt_bench [--min-time seconds] [名字过滤...]
+// A benchmark runs if its name contains any of the filters, or if none are given.
+
+#include "rtweekend.h"
+#include "aabb.h"
+#include "bvh.h"
+#include "framebuffer.h"
+#include "hittable_list.h"
+#include "image_writer.h"
+#include "material.h"
+#include "perlin.h"
+#include "quad.h"
+#include "sphere.h"
+#include "texture.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace
+{
+    const int trials = 5;
+    const size_t input_count = 1 << 16; // 每遍的输入个数，放得进 L2
+
+    struct bench_options
+    {
+        double min_time = 1.0;
+        std::vector<std::string> filters;
+    };
+
+    // 输入生成器的固定种子；每个基准用自己的 stream
+    void pin_seed(uint64_t stream)
+    {
+        thread_rng().seed(0x5eed0f7a11be7c4ULL, stream);
+    }
+
+    // 半径为 distance 的球面上随机一点射向 [-extent, extent]^3 中随机一点，大约一半的光线击中单位大小的目标
+    std::vector<ray> make_rays(double distance, double extent, bool timed)
+    {
+        std::vector<ray> rays;
+        rays.reserve(input_count);
+        for (size_t i = 0; i < input_count; i++)
+        {
+            point3 origin = distance * random_unit_vector();
+            point3 target = vec3::random(-extent, extent);
+            rays.push_back(ray(origin, target - origin, timed ? random_double() : 0.0));
+        }
+        return rays;
+    }
+
+    double hit_sum(const hittable &object, const std::vector<ray> &rays)
+    {
+        double sum = 0;
+        hit_record rec;
+        for (const auto &r : rays)
+        {
+            if (object.hit(r, interval(0.001, infinity), rec))
+                sum += rec.t;
+        }
+        return sum;
+    }
+
+    // 一遍处理 ops 个操作；返回值累加成校验和，同时防止编译器删掉被测代码
+    struct benchmark
+    {
+        std::string name;
+        const char *unit; // 每个操作是什么：ray、primitive、point……
+        size_t ops;
+        std::function<double()> pass;
+    };
+
+    void run(const benchmark &b, const bench_options &options)
+    {
+        typedef std::chrono::steady_clock clock;
+
+        double checksum = b.pass();
+
+        // 估计一遍的时间，让每次试验至少持续 min_time / trials
+        auto start = clock::now();
+        b.pass();
+        double once = std::chrono::duration<double>(clock::now() - start).count();
+        double trial_time = options.min_time / trials;
+        long passes = once > 0 ? std::max(1L, long(trial_time / once)) : 1L;
+
+        double best = infinity;
+        volatile double sink = 0;
+        for (int t = 0; t < trials; t++)
+        {
+            start = clock::now();
+            for (long p = 0; p < passes; p++)
+                sink = sink + b.pass();
+            double seconds = std::chrono::duration<double>(clock::now() - start).count();
+            best = std::min(best, seconds / (double(passes) * b.ops));
+        }
+
+        std::printf("%-28s %10.2f ns/op %10.2f M%ss/s   checksum %.9g\n", b.name.c_str(), best * 1e9,
+                    1e-6 / best, b.unit, checksum);
+        std::fflush(stdout);
+    }
+
+    bool selected(const std::string &name, const bench_options &options)
+    {
+        if (options.filters.empty())
+            return true;
+        for (const auto &f : options.filters)
+        {
+            if (name.find(f) != std::string::npos)
+                return true;
+        }
+        return false;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    bench_options options;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--min-time" && i + 1 < argc)
+            options.min_time = std::atof(argv[++i]);
+        else
+            options.filters.push_back(arg);
+    }
+
+    std::printf("Geometry in %s (rt_bench_float is the single-precision build)\n", RT_FLOAT ? "float" : "double");
+
+    auto grey = make_shared<lambertian>(color(.5, .5, .5));
+    std::vector<benchmark> benchmarks;
+
+    // Each benchmark owns its inputs through shared_ptrs captured by the pass, so setup cost is
+    // paid once when the list is built and never timed.
+    {
+        pin_seed(1);
+        auto rays = make_shared<std::vector<ray>>(make_rays(5, 1.5, false));
+        auto ball = make_shared<sphere>(point3(0, 0, 0), 1.0, grey);
+        benchmarks.push_back(benchmark{"sphere::hit (static)", "ray", input_count, [=]() { return hit_sum(*ball, *rays); }});
+    }
+    {
+        pin_seed(2);
+        auto rays = make_shared<std::vector<ray>>(make_rays(5, 1.5, true));
+        auto ball = make_shared<sphere>(point3(0, 0, 0), point3(0, 0.5, 0), 1.0, grey);
+        benchmarks.push_back(benchmark{"sphere::hit (moving)", "ray", input_count, [=]() { return hit_sum(*ball, *rays); }});
+    }
+    {
+        pin_seed(3);
+        auto rays = make_shared<std::vector<ray>>(make_rays(5, 1.5, false));
+        auto face = make_shared<quad>(point3(-1, -1, 0), vec3(2, 0, 0), vec3(0, 2, 0), grey);
+        benchmarks.push_back(benchmark{"quad::hit", "ray", input_count, [=]() { return hit_sum(*face, *rays); }});
+    }
+    {
+        pin_seed(4);
+        auto rays = make_shared<std::vector<ray>>(make_rays(5, 1.5, false));
+        auto box = make_shared<aabb>(point3(-1, -1, -1), point3(1, 1, 1));
+        benchmarks.push_back(benchmark{"aabb::hit", "ray", input_count, [=]()
+        {
+            double hits = 0;
+            for (const auto &r : *rays)
+                hits += box->hit(r, interval(0.001, infinity)) ? 1 : 0;
+            return hits;
+        }});
+    }
+    {
+        // 一万个随机小球，约三分之一的光线击中
+        pin_seed(5);
+        auto spheres = make_shared<hittable_list>();
+        for (int i = 0; i < 10000; i++)
+            spheres->add(make_shared<sphere>(vec3::random(-10, 10), random_double(0.05, 0.2), grey));
+        auto tree = make_shared<BVHNode>(*spheres);
+        auto rays = make_shared<std::vector<ray>>(make_rays(30, 10, false));
+
+        benchmarks.push_back(benchmark{"BVHNode build (10k spheres)", "primitive", spheres->objects.size(), [=]()
+        {
+            BVHNode built(*spheres);
+            return built.bounding_box().x.size();
+        }});
+        benchmarks.push_back(benchmark{"BVHNode::hit (10k spheres)", "ray", input_count, [=]() { return hit_sum(*tree, *rays); }});
+    }
+    {
+        pin_seed(6);
+        auto noise = make_shared<perlin>();
+        auto points = make_shared<std::vector<point3>>();
+        for (size_t i = 0; i < input_count; i++)
+            points->push_back(vec3::random(-10, 10));
+        benchmarks.push_back(benchmark{"perlin::noise", "point", input_count, [=]()
+        {
+            double sum = 0;
+            for (const auto &p : *points)
+                sum += noise->noise(p);
+            return sum;
+        }});
+    }
+    {
+        // 生成一张 1024x512 的图像写成 PPM 再读回，不依赖仓库外的图片文件
+        pin_seed(7);
+        const char *path = "rt_bench_texture.ppm";
+        framebuffer pixels(1024, 512);
+        for (int y = 0; y < pixels.height(); y++)
+            for (int x = 0; x < pixels.width(); x++)
+                pixels.set(x, y, color::random());
+        write_image(path, pixels);
+        auto texture = make_shared<image_texture>(path);
+        std::remove(path);
+
+        auto uvs = make_shared<std::vector<vec3>>();
+        for (size_t i = 0; i < input_count; i++)
+            uvs->push_back(vec3(random_double(), random_double(), 0));
+        benchmarks.push_back(benchmark{"image_texture::value", "lookup", input_count, [=]()
+        {
+            double sum = 0;
+            for (const auto &uv : *uvs)
+                sum += texture->value(uv.x(), uv.y(), uv).x();
+            return sum;
+        }});
+    }
+    benchmarks.push_back(benchmark{"random_unit_vector", "vector", input_count, []()
+    {
+        pin_seed(8);
+        double sum = 0;
+        for (size_t i = 0; i < input_count; i++)
+            sum += random_unit_vector().x();
+        return sum;
+    }});
+
+    for (const auto &b : benchmarks)
+    {
+        if (selected(b.name, options))
+            run(b, options);
+    }
+    return 0;
+}
@@ -7,12 +7,30 @@
 #include <limits>
 #include <memory>
 
+#include "rng.h"
+#include "sampler.h"
+
 // C++ Std Usings
 using std::fabs;
 using std::make_shared;
 using std::shared_ptr;
 using std::sqrt;
 
+// 标量类型
+// The component type of vec3 (and so of point3 and color), ray, interval and aabb. double by
+// default; building with RT_FLOAT=1 (the CMake target TheNextWeek_float) makes it float, halving
+// the size of geometry and of the primitive arrays. Sampling, random numbers, pdfs and the
+// per-pixel statistics stay double in both builds.
+#ifndef RT_FLOAT
+#define RT_FLOAT 0
+#endif
+
+#if RT_FLOAT
+typedef float real;
+#else
+typedef double real;
+#endif
+
 // 常量
 
 const double infinity = std::numeric_limits<double>::infinity(); // 无穷大
@@ -26,10 +44,18 @@ inline double degrees_to_radians(double degrees)
     return degrees * pi / 180.0;
 }
 
+// 浮点误差界 γ(n) = nε / (1 - nε)，ε 是 real 的单位舍入（半个 epsilon）。
+// n 次舍入的运算结果与精确值的相对误差不超过 γ(n)（PBRT 3.9 节），用于求交点的误差界
+inline real error_gamma(int n)
+{
+    const real unit_roundoff = std::numeric_limits<real>::epsilon() / 2;
+    return (n * unit_roundoff) / (1 - n * unit_roundoff);
+}
+
 inline double random_double()
 {
-    // 返回一个在[0,1)范围内的随机实数
-    return rand() / (RAND_MAX + 1.0);
+    // 返回一个在[0,1)范围内的随机实数：渲染时取当前采样器的下一维，否则使用当前线程的生成器，无锁
+    return next_sample();
 }
 
 inline double random_double(double min, double max)
@@ -50,4 +76,5 @@ inline int random_int(int min, int max)
 #include "vec3.h"
 #include "ray.h"
 #include "interval.h"
+#include "render_stats.h"
 #endif
\ No newline at end of file
@@ -0,0 +1,310 @@
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include "rng.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <memory>
+
+// 采样器
+// Supplies the numbers a path consumes. The path is split into dimensions: the camera ray uses
+// the first block (pixel jitter, time) and every later vertex gets a block of its own (BSDF, light
+// position, light choice, roulette). A sampler maps (seed, pixel, sample index, dimension) to a
+// number in [0,1) as a pure function, so it keeps no per-thread state and a resumed render
+// draws the same values as an uninterrupted one.
+//
+// Consecutive dimensions 2k and 2k+1 form a pair; the low-discrepancy samplers stratify each
+// pair jointly, so two-dimensional decisions (pixel position, a direction, a point on a light)
+// should start on an even dimension.
+class sampler
+{
+public:
+    virtual ~sampler() = default;
+
+    virtual double get(uint64_t seed, uint64_t pixel, uint32_t sample, uint32_t dimension) const = 0;
+};
+
+// 每个路径顶点占用的维数
+const uint32_t sample_dimensions_per_vertex = 8;
+
+// 一个路径顶点内各维的用途
+enum sample_dimension : uint32_t
+{
+    dimension_pixel = 0,     // 相机光线：像素内偏移 (0,1) 和时间 (2)
+    dimension_time = 2,
+    dimension_scatter = 0,   // 之后的顶点：散射方向 (0,1)
+    dimension_light = 2,     // 光源上的点 (2,3)
+    dimension_light_pick = 4,
+    dimension_roulette = 5,
+};
+
+// 当前线程正在采样的路径。random_double() 按维依次取值，超出本顶点维数的部分（例如拒绝采样的循环）
+// 以及 active 为空时退回到 thread_rng()。
+struct sample_state
+{
+    const sampler *active = nullptr;
+    uint64_t seed = 0;
+    uint64_t pixel = 0;
+    uint32_t sample = 0;
+    uint32_t base = 0;      // 当前顶点的第一维
+    uint32_t dimension = 0; // 下一次取值的维
+};
+
+inline sample_state &thread_sample_state()
+{
+    static thread_local sample_state state;
+    return state;
+}
+
+// Seeds the calling thread's generator from a (pixel, sample, bounce) triple. The sequence a path
+// consumes then depends only on these counters, not on which thread renders it or in what order.
+// All four are hashed into the starting state on one fixed stream: PCG streams that differ only
+// in their increment are correlated, so the bounce must not just pick the stream.
+// It also moves the active sampler to the first dimension of vertex `bounce`.
+inline void seed_random(uint64_t scene_seed, uint64_t pixel, uint64_t sample, uint64_t bounce)
+{
+    uint64_t key = mix_bits(scene_seed ^ mix_bits(pixel ^ mix_bits(sample ^ mix_bits(bounce))));
+    thread_rng().seed(key, pcg32::default_stream);
+
+    sample_state &state = thread_sample_state();
+    state.seed = scene_seed;
+    state.pixel = pixel;
+    state.sample = uint32_t(sample);
+    state.base = uint32_t(bounce) * sample_dimensions_per_vertex;
+    state.dimension = state.base;
+}
+
+// 让下一次 random_double() 取当前顶点的第 dimension 维
+inline void start_dimension(uint32_t dimension)
+{
+    sample_state &state = thread_sample_state();
+    state.dimension = state.base + dimension;
+}
+
+inline double next_sample()
+{
+    sample_state &state = thread_sample_state();
+    if (state.active && state.dimension < state.base + sample_dimensions_per_vertex)
+        return state.active->get(state.seed, state.pixel, state.sample, state.dimension++);
+    return thread_rng().next_double();
+}
+
+// 在作用域内为当前线程设置采样器，离开时恢复
+class scoped_sampler
+{
+public:
+    explicit scoped_sampler(const sampler *s) : previous(thread_sample_state().active)
+    {
+        thread_sample_state().active = s;
+    }
+    ~scoped_sampler() { thread_sample_state().active = previous; }
+
+    scoped_sampler(const scoped_sampler &) = delete;
+    scoped_sampler &operator=(const scoped_sampler &) = delete;
+
+private:
+    const sampler *previous;
+};
+
+namespace sampling
+{
+    const double one_minus_epsilon = 1.0 - std::numeric_limits<double>::epsilon() / 2;
+
+    inline uint32_t hash(uint64_t a, uint64_t b, uint64_t c)
+    {
+        return uint32_t(mix_bits(a ^ mix_bits(b ^ mix_bits(c))));
+    }
+
+    inline uint32_t reverse_bits(uint32_t x)
+    {
+        x = (x << 16) | (x >> 16);
+        x = ((x & 0x00ff00ffu) << 8) | ((x & 0xff00ff00u) >> 8);
+        x = ((x & 0x0f0f0f0fu) << 4) | ((x & 0xf0f0f0f0u) >> 4);
+        x = ((x & 0x33333333u) << 2) | ((x & 0xccccccccu) >> 2);
+        x = ((x & 0x55555555u) << 1) | ((x & 0xaaaaaaaau) >> 1);
+        return x;
+    }
+
+    // Hash-based Owen scrambling of a bit-reversed value (Burley, "Practical Hash-based Owen
+    // Scrambling", JCGT 2020): flipping each bit depends only on the bits above it.
+    inline uint32_t laine_karras_permutation(uint32_t x, uint32_t seed)
+    {
+        x += seed;
+        x ^= x * 0x6c50b47cu;
+        x ^= x * 0xb82f1e52u;
+        x ^= x * 0xc7afe638u;
+        x ^= x * 0x8d22f6e6u;
+        return x;
+    }
+
+    inline uint32_t nested_uniform_scramble(uint32_t x, uint32_t seed)
+    {
+        return reverse_bits(laine_karras_permutation(reverse_bits(x), seed));
+    }
+
+    // Element i of a pseudo-random permutation of [0, n) (Kensler, "Correlated Multi-Jittered
+    // Sampling", 2013).
+    inline uint32_t permutation_element(uint32_t i, uint32_t n, uint32_t p)
+    {
+        uint32_t w = n - 1;
+        w |= w >> 1;
+        w |= w >> 2;
+        w |= w >> 4;
+        w |= w >> 8;
+        w |= w >> 16;
+        do
+        {
+            i ^= p;
+            i *= 0xe170893du;
+            i ^= p >> 16;
+            i ^= (i & w) >> 4;
+            i ^= p >> 8;
+            i *= 0x0929eb3fu;
+            i ^= p >> 23;
+            i ^= (i & w) >> 1;
+            i *= 1 | p >> 27;
+            i *= 0x6935fa69u;
+            i ^= (i & w) >> 11;
+            i *= 0x74dcb303u;
+            i ^= (i & w) >> 2;
+            i *= 0x9e501cc3u;
+            i ^= (i & w) >> 2;
+            i *= 0xc860a3dfu;
+            i &= w;
+            i ^= i >> 5;
+        } while (i >= n);
+        return (i + p) % n;
+    }
+
+    inline double to_unit(uint32_t bits)
+    {
+        double u = bits * (1.0 / 4294967296.0);
+        return u < one_minus_epsilon ? u : one_minus_epsilon;
+    }
+}
+
+// 独立采样：每一维都是独立的伪随机数，即原来的行为
+class independent_sampler : public sampler
+{
+public:
+    double get(uint64_t, uint64_t, uint32_t, uint32_t) const override
+    {
+        return thread_rng().next_double();
+    }
+};
+
+// 分层采样：每一维把像素的 samples_per_pixel 个样本各放进 [0,1) 的一个等分区间并在区间内抖动，
+// 各维使用独立的随机排列（拉丁超立方）。超过 samples_per_pixel 的样本退回独立采样。
+class stratified_sampler : public sampler
+{
+public:
+    explicit stratified_sampler(uint32_t samples_per_pixel) : strata(samples_per_pixel) {}
+
+    double get(uint64_t seed, uint64_t pixel, uint32_t sample, uint32_t dimension) const override
+    {
+        if (sample >= strata)
+            return thread_rng().next_double();
+        uint32_t h = sampling::hash(seed, pixel, dimension);
+        uint32_t stratum = sampling::permutation_element(sample, strata, h);
+        double jitter = sampling::to_unit(sampling::hash(h, sample, 0x5f3759dfu));
+        return std::min((stratum + jitter) / strata, sampling::one_minus_epsilon);
+    }
+
+private:
+    uint32_t strata;
+};
+
+// Halton 序列：每对维取以 2 和 3 为底的根式反演，数字逐位做嵌套随机平移（Owen 式置乱）。
+// 每对维的样本序号在前 samples_per_pixel 个之间随机重排，使不同维对之间互不相关，
+// 而每对维用到的点集仍是完整的 Halton 前缀。
+class halton_sampler : public sampler
+{
+public:
+    explicit halton_sampler(uint32_t samples_per_pixel) : count(samples_per_pixel) {}
+
+    double get(uint64_t seed, uint64_t pixel, uint32_t sample, uint32_t dimension) const override
+    {
+        uint32_t h = sampling::hash(seed, pixel, dimension >> 1);
+        uint32_t index = sample < count ? sampling::permutation_element(sample, count, h) : sample;
+        uint32_t base = (dimension & 1) ? 3 : 2;
+        return scrambled_radical_inverse(index, base, mix_bits(h ^ ((dimension & 1) + 1)));
+    }
+
+private:
+    uint32_t count;
+
+    static double scrambled_radical_inverse(uint32_t index, uint32_t base, uint64_t seed)
+    {
+        // The shift of each digit depends on all digits before it, which the leading 1 of
+        // `prefix` makes unique per position.
+        double inv_base = 1.0 / base, scale = inv_base, result = 0;
+        uint64_t prefix = 1;
+        while (index > 0)
+        {
+            uint32_t digit = index % base;
+            index /= base;
+            uint32_t shift = uint32_t(mix_bits(seed ^ (prefix * 0x9e3779b97f4a7c15ULL)) % base);
+            result += ((digit + shift) % base) * scale;
+            prefix = prefix * base + digit;
+            scale *= inv_base;
+        }
+        // The remaining digits are scrambled zeros, each shifted independently, so together
+        // they are uniform over the last interval.
+        result += sampling::to_unit(uint32_t(mix_bits(seed ^ (prefix * 0x9e3779b97f4a7c15ULL)))) * scale * base;
+        return std::min(result, sampling::one_minus_epsilon);
+    }
+};
+
+// Owen 置乱的 Sobol 序列。每对维使用 Sobol 的前两维（(0,2) 序列），样本序号和两个分量各自经过
+// 基于哈希的 Owen 置乱，不同的维对之间因此互不相关（Burley 2020 的 padding 做法）。
+// 样本数为 2 的幂时每对维都是分层的。
+class sobol_sampler : public sampler
+{
+public:
+    double get(uint64_t seed, uint64_t pixel, uint32_t sample, uint32_t dimension) const override
+    {
+        uint32_t h = sampling::hash(seed, pixel, dimension >> 1);
+        uint32_t index = sampling::nested_uniform_scramble(sample, h);
+        uint32_t bits = (dimension & 1) ? sobol_second(index) : sampling::reverse_bits(index);
+        return sampling::to_unit(sampling::nested_uniform_scramble(bits, sampling::hash(h, dimension & 1, 0x1b873593u)));
+    }
+
+private:
+    // Sobol 的第二维：本原多项式 x + 1，方向数 v_k = v_(k-1) ^ (v_(k-1) >> 1)
+    static uint32_t sobol_second(uint32_t index)
+    {
+        uint32_t result = 0;
+        for (uint32_t v = 1u << 31; index; index >>= 1, v ^= v >> 1)
+            if (index & 1)
+                result ^= v;
+        return result;
+    }
+};
+
+enum class sampler_kind
+{
+    independent,
+    stratified,
+    halton,
+    sobol,
+};
+
+inline std::unique_ptr<sampler> make_sampler(sampler_kind kind, int samples_per_pixel)
+{
+    uint32_t count = uint32_t(std::max(1, samples_per_pixel));
+    switch (kind)
+    {
+    case sampler_kind::stratified:
+        return std::unique_ptr<sampler>(new stratified_sampler(count));
+    case sampler_kind::halton:
+        return std::unique_ptr<sampler>(new halton_sampler(count));
+    case sampler_kind::sobol:
+        return std::unique_ptr<sampler>(new sobol_sampler());
+    default:
+        return std::unique_ptr<sampler>(new independent_sampler());
+    }
+}
+
+#endif
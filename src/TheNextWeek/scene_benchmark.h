@@ -0,0 +1,404 @@
+#ifndef SCENE_BENCHMARK_H
+#define SCENE_BENCHMARK_H
+
+#include "rtweekend.h"
+#include "camera.h"
+#include "framebuffer.h"
+#include "scenes.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+// 整场景吞吐量基准
+// Renders each scene at a fixed width and sample count and reports, as JSON, how long the scene
+// took to build, how long it took to trace, the rays traced per second and the peak resident
+// memory. Given a baseline (an earlier run's JSON) it flags every scene that got slower or bigger
+// by more than the tolerance and exits non-zero, so a regression fails the build that caused it.
+//
+// 用法：TheNextWeek --benchmark [--width N] [--spp N] [--threads N] [--output results.json]
+//                                [--baseline baseline.json] [--tolerance 0.1] [场景...]
+//
+// Each result records the build's scalar type. To compare single against double precision, run
+// TheNextWeek --benchmark --output double.json, then TheNextWeek_float --benchmark --baseline
+// double.json.
+
+// 峰值常驻内存（字节）
+// On Linux the peak is reset before each scene (writing 5 to /proc/self/clear_refs), so each
+// scene reports its own peak; elsewhere it is the process's peak so far.
+namespace peak_memory
+{
+    inline void reset()
+    {
+#if defined(__linux__)
+        std::ofstream clear("/proc/self/clear_refs");
+        if (clear)
+            clear << "5";
+#endif
+    }
+
+    inline uint64_t bytes()
+    {
+#if defined(_WIN32)
+        PROCESS_MEMORY_COUNTERS counters;
+        if (K32GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+            return uint64_t(counters.PeakWorkingSetSize);
+        return 0;
+#else
+#if defined(__linux__)
+        std::ifstream status("/proc/self/status");
+        std::string line;
+        while (std::getline(status, line))
+        {
+            if (line.compare(0, 6, "VmHWM:") == 0)
+                return uint64_t(std::strtoull(line.c_str() + 6, nullptr, 10)) * 1024;
+        }
+#endif
+        struct rusage usage;
+        if (getrusage(RUSAGE_SELF, &usage) != 0)
+            return 0;
+#if defined(__APPLE__)
+        return uint64_t(usage.ru_maxrss); // macOS 以字节为单位
+#else
+        return uint64_t(usage.ru_maxrss) * 1024;
+#endif
+#endif
+    }
+}
+
+struct benchmark_settings
+{
+    int image_width = 320;
+    int samples_per_pixel = 16;
+    int thread_count = 0;
+    double tolerance = 0.10; // 允许的相对变化
+    std::string output_path; // 为空时 JSON 写到标准输出
+    std::string baseline_path;
+    std::vector<std::string> scenes = {"checkered_spheres", "earth", "perlin_spheres", "quads", "simple_light", "cornell_box"};
+};
+
+struct scene_measurement
+{
+    std::string name;
+    std::string scalar = RT_FLOAT ? "float" : "double"; // real 的类型
+    int width = 0, height = 0, samples_per_pixel = 0, threads = 0;
+    double build_seconds = 0;
+    double trace_seconds = 0;
+    uint64_t rays = 0;
+    double mrays_per_second = 0;
+    uint64_t peak_rss_bytes = 0;
+};
+
+namespace benchmark_json
+{
+    // 只读本基准写出的 JSON：对象、数组、字符串、数字。每个场景对象展开成 键 -> 文本值
+    class reader
+    {
+    public:
+        explicit reader(const std::string &text) : p(text.c_str()), end(text.c_str() + text.size()) {}
+
+        bool scenes(std::vector<std::map<std::string, std::string>> &out)
+        {
+            std::map<std::string, std::string> top;
+            return parse_object(top, &out) && (skip(), p == end);
+        }
+
+    private:
+        const char *p;
+        const char *end;
+
+        void skip()
+        {
+            while (p < end && (*p == ' ' || *p == '\n' || *p == '\r' || *p == '\t'))
+                p++;
+        }
+
+        bool expect(char c)
+        {
+            skip();
+            if (p >= end || *p != c)
+                return false;
+            p++;
+            return true;
+        }
+
+        bool parse_string(std::string &out)
+        {
+            if (!expect('"'))
+                return false;
+            out.clear();
+            while (p < end && *p != '"')
+            {
+                if (*p == '\\' && p + 1 < end)
+                    p++;
+                out += *p++;
+            }
+            return expect('"');
+        }
+
+        bool parse_scalar(std::string &out)
+        {
+            skip();
+            if (p < end && *p == '"')
+                return parse_string(out);
+            const char *start = p;
+            while (p < end && *p != ',' && *p != '}' && *p != ']' && *p != ' ' && *p != '\n' && *p != '\r' && *p != '\t')
+                p++;
+            out.assign(start, p);
+            return p > start;
+        }
+
+        // scenes 非空时，键 "scenes" 的数组元素写到 scenes 里
+        bool parse_object(std::map<std::string, std::string> &fields, std::vector<std::map<std::string, std::string>> *scenes)
+        {
+            if (!expect('{'))
+                return false;
+            skip();
+            if (p < end && *p == '}')
+                return expect('}');
+            do
+            {
+                std::string key;
+                if (!parse_string(key) || !expect(':'))
+                    return false;
+                skip();
+                if (scenes && key == "scenes")
+                {
+                    if (!expect('['))
+                        return false;
+                    skip();
+                    if (p < end && *p == ']')
+                    {
+                        p++;
+                        continue;
+                    }
+                    do
+                    {
+                        scenes->push_back(std::map<std::string, std::string>());
+                        if (!parse_object(scenes->back(), nullptr))
+                            return false;
+                    } while (expect(','));
+                    if (!expect(']'))
+                        return false;
+                }
+                else if (!parse_scalar(fields[key]))
+                    return false;
+            } while (expect(','));
+            return expect('}');
+        }
+    };
+
+    inline std::string quote(const std::string &text)
+    {
+        std::string out = "\"";
+        for (char c : text)
+        {
+            if (c == '"' || c == '\\')
+                out += '\\';
+            out += c;
+        }
+        return out + "\"";
+    }
+
+    inline void write(std::ostream &out, const std::vector<scene_measurement> &results)
+    {
+        out.precision(6);
+        out << "{\n  \"scenes\": [";
+        for (size_t i = 0; i < results.size(); i++)
+        {
+            const auto &m = results[i];
+            out << (i ? ",\n" : "\n") << "    {\"name\": " << quote(m.name) << ", \"scalar\": " << quote(m.scalar) << ", \"width\": " << m.width
+                << ", \"height\": " << m.height << ", \"samples_per_pixel\": " << m.samples_per_pixel
+                << ", \"threads\": " << m.threads << ", \"build_seconds\": " << m.build_seconds
+                << ", \"trace_seconds\": " << m.trace_seconds << ", \"rays\": " << m.rays
+                << ", \"mrays_per_second\": " << m.mrays_per_second << ", \"peak_rss_bytes\": " << m.peak_rss_bytes << "}";
+        }
+        out << "\n  ]\n}\n";
+    }
+}
+
+// 渲染一个场景并测量；场景无法构建时返回 false
+inline bool measure_scene(const std::string &name, const benchmark_settings &settings, scene_resources &resources,
+                          scene_measurement &m)
+{
+    typedef std::chrono::steady_clock clock;
+
+    peak_memory::reset();
+    thread_rng().seed(0x5eed0f7a11be7c4ULL, 0); // 随机生成的场景每次都一样，与运行顺序无关
+
+    auto start = clock::now();
+    auto built = make_scene(name, resources);
+    m.build_seconds = std::chrono::duration<double>(clock::now() - start).count();
+    if (!built)
+        return false;
+
+    camera cam(built->view);
+    cam.image_width = settings.image_width;
+    cam.samples_per_pixel = settings.samples_per_pixel;
+    cam.thread_count = settings.thread_count;
+    cam.adaptive_sampling = false;
+    cam.pass_samples = 0;
+    cam.preview_path.clear();
+    cam.checkpoint_path.clear();
+
+    framebuffer image;
+    start = clock::now();
+    cam.render(*built->world, image);
+    m.trace_seconds = std::chrono::duration<double>(clock::now() - start).count();
+
+    m.name = name;
+    m.width = image.width();
+    m.height = image.height();
+    m.samples_per_pixel = cam.samples_per_pixel;
+    m.threads = thread_pool::worker_count(cam.thread_count);
+    m.rays = cam.ray_count();
+    m.mrays_per_second = m.trace_seconds > 0 ? double(m.rays) / m.trace_seconds * 1e-6 : 0;
+    m.peak_rss_bytes = peak_memory::bytes();
+    return true;
+}
+
+// 与基准线比较；返回超出容差的场景数。尺寸、采样数或线程数不同的场景不比较
+inline int compare_to_baseline(const std::vector<scene_measurement> &results, const std::string &path, double tolerance)
+{
+    std::ifstream in(path);
+    std::vector<std::map<std::string, std::string>> baseline;
+    std::stringstream text;
+    text << in.rdbuf();
+    if (!in || !benchmark_json::reader(text.str()).scenes(baseline))
+    {
+        std::cerr << "ERROR: Could not read benchmark baseline '" << path << "'.\n";
+        return 1;
+    }
+
+    // 构建时间很短的场景只看超出的绝对量，避免毫秒级的抖动被当成回归
+    const double build_slack = 0.005;
+
+    int regressions = 0;
+    for (const auto &m : results)
+    {
+        const std::map<std::string, std::string> *base = nullptr;
+        for (const auto &b : baseline)
+        {
+            auto name = b.find("name");
+            if (name != b.end() && name->second == m.name)
+                base = &b;
+        }
+        auto number = [&](const char *key) {
+            auto found = base->find(key);
+            return found == base->end() ? 0.0 : std::atof(found->second.c_str());
+        };
+        if (!base)
+        {
+            std::clog << m.name << ": not in baseline\n";
+            continue;
+        }
+        if (number("width") != m.width || number("height") != m.height ||
+            number("samples_per_pixel") != m.samples_per_pixel || number("threads") != m.threads)
+        {
+            std::clog << m.name << ": baseline was measured with different settings, not compared\n";
+            continue;
+        }
+        auto scalar = base->find("scalar");
+        if (scalar != base->end() && scalar->second != m.scalar)
+            std::clog << m.name << ": " << m.scalar << " build against a " << scalar->second << " baseline\n";
+
+        auto check = [&](const char *what, double now, double before, bool higher_is_better, double slack) {
+            double change = before > 0 ? now / before - 1 : 0;
+            bool worse = higher_is_better ? change < -tolerance : (change > tolerance && now - before > slack);
+            std::clog << m.name << ": " << what << ' ' << before << " -> " << now << " (" << (change >= 0 ? "+" : "")
+                      << change * 100 << "%)" << (worse ? "  REGRESSION" : "") << '\n';
+            regressions += worse ? 1 : 0;
+        };
+        check("Mrays/s", m.mrays_per_second, number("mrays_per_second"), true, 0);
+        check("build s", m.build_seconds, number("build_seconds"), false, build_slack);
+        check("peak RSS", double(m.peak_rss_bytes), number("peak_rss_bytes"), false, 0);
+    }
+    return regressions;
+}
+
+// 返回进程的退出码：0 表示全部完成且没有回归
+inline int run_benchmark(int argc, char *argv[])
+{
+    benchmark_settings settings;
+    std::vector<std::string> names;
+    for (int i = 0; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--width" && has_value)
+            settings.image_width = std::atoi(argv[++i]);
+        else if (arg == "--spp" && has_value)
+            settings.samples_per_pixel = std::atoi(argv[++i]);
+        else if (arg == "--threads" && has_value)
+            settings.thread_count = std::atoi(argv[++i]);
+        else if (arg == "--tolerance" && has_value)
+            settings.tolerance = std::atof(argv[++i]);
+        else if (arg == "--output" && has_value)
+            settings.output_path = argv[++i];
+        else if (arg == "--baseline" && has_value)
+            settings.baseline_path = argv[++i];
+        else if (arg.compare(0, 2, "--") == 0)
+        {
+            std::cerr << "ERROR: Unknown benchmark option '" << arg << "'.\n";
+            return 1;
+        }
+        else
+            names.push_back(arg);
+    }
+    if (!names.empty())
+        settings.scenes = names;
+
+    scene_resources resources;
+    std::vector<scene_measurement> results;
+    bool complete = true;
+    for (const auto &name : settings.scenes)
+    {
+        std::clog << "Benchmark: " << name << '\n';
+        scene_measurement m;
+        if (measure_scene(name, settings, resources, m))
+            results.push_back(m);
+        else
+            complete = false;
+    }
+
+    if (settings.output_path.empty())
+        benchmark_json::write(std::cout, results);
+    else
+    {
+        std::ofstream out(settings.output_path);
+        benchmark_json::write(out, results);
+        out.close();
+        if (!out)
+        {
+            std::cerr << "ERROR: Could not write benchmark results '" << settings.output_path << "'.\n";
+            complete = false;
+        }
+    }
+
+    int regressions = 0;
+    if (!settings.baseline_path.empty())
+    {
+        regressions = compare_to_baseline(results, settings.baseline_path, settings.tolerance);
+        std::clog << regressions << " regression(s) beyond " << settings.tolerance * 100 << "% of the baseline\n";
+    }
+    return complete && regressions == 0 ? 0 : 1;
+}
+
+#endif
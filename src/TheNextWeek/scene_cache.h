@@ -0,0 +1,312 @@
+#ifndef SCENE_CACHE_H
+#define SCENE_CACHE_H
+
+#include "mapped_file.h"
+#include "bvh_builder.h"
+#include "linear_bvh.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+// 缓存文件的格式版本；写入的数组布局或生成它们的方式（解析、BVH 构建）改变时加一
+static const uint32_t cache_format_version = 2;
+
+// 64 位内容哈希
+// Four independent multiply-rotate lanes over 32-byte stripes (the structure of xxHash64), fast
+// enough to hash a large model file or a million staged primitives in milliseconds. Input can be
+// added in pieces; the result depends only on the concatenated bytes.
+class content_hasher
+{
+public:
+    explicit content_hasher(uint64_t seed = 0)
+    {
+        lanes[0] = seed + prime1 + prime2;
+        lanes[1] = seed + prime2;
+        lanes[2] = seed;
+        lanes[3] = seed - prime1;
+    }
+
+    void add(const void *data, size_t bytes)
+    {
+        const unsigned char *p = static_cast<const unsigned char *>(data);
+        total += bytes;
+        if (pending > 0)
+        {
+            size_t take = std::min(bytes, sizeof(buffer) - pending);
+            std::memcpy(buffer + pending, p, take);
+            pending += take;
+            p += take;
+            bytes -= take;
+            if (pending < sizeof(buffer))
+                return;
+            stripe(buffer);
+            pending = 0;
+        }
+        for (; bytes >= sizeof(buffer); p += sizeof(buffer), bytes -= sizeof(buffer))
+            stripe(p);
+        std::memcpy(buffer, p, bytes);
+        pending = bytes;
+    }
+
+    template <typename T>
+    void add_value(const T &value) { add(&value, sizeof(T)); }
+
+    template <typename T>
+    void add_array(const std::vector<T> &values)
+    {
+        add_value(uint64_t(values.size()));
+        if (!values.empty())
+            add(values.data(), values.size() * sizeof(T));
+    }
+
+    // BVH 构建参数也是缓存内容的一部分
+    void add_options(const bvh_build_options &options)
+    {
+        add_value(int32_t(options.max_leaf_size));
+        add_value(int32_t(options.bin_count));
+        add_value(options.traversal_cost);
+        add_value(options.intersection_cost);
+    }
+
+    uint64_t value() const
+    {
+        uint64_t h = rotl(lanes[0], 1) + rotl(lanes[1], 7) + rotl(lanes[2], 12) + rotl(lanes[3], 18);
+        for (int i = 0; i < 4; i++)
+            h = (h ^ round(0, lanes[i])) * prime1 + prime4;
+        h += total;
+        for (size_t i = 0; i < pending; i++)
+            h = rotl(h ^ (buffer[i] * prime5), 11) * prime1;
+        h ^= h >> 33;
+        h *= prime2;
+        h ^= h >> 29;
+        h *= prime3;
+        h ^= h >> 32;
+        return h;
+    }
+
+private:
+    static const uint64_t prime1 = 0x9E3779B185EBCA87ULL;
+    static const uint64_t prime2 = 0xC2B2AE3D27D4EB4FULL;
+    static const uint64_t prime3 = 0x165667B19E3779F9ULL;
+    static const uint64_t prime4 = 0x85EBCA77C2B2AE63ULL;
+    static const uint64_t prime5 = 0x27D4EB2F165667C5ULL;
+
+    uint64_t lanes[4];
+    unsigned char buffer[32];
+    size_t pending = 0;
+    uint64_t total = 0;
+
+    static uint64_t rotl(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+    static uint64_t round(uint64_t acc, uint64_t input) { return rotl(acc + input * prime2, 31) * prime1; }
+
+    void stripe(const unsigned char *p)
+    {
+        for (int i = 0; i < 4; i++)
+        {
+            uint64_t word;
+            std::memcpy(&word, p + i * 8, 8);
+            lanes[i] = round(lanes[i], word);
+        }
+    }
+};
+
+// 缓存文件的内容类型
+enum cache_kind : uint32_t
+{
+    cache_triangle_mesh = 1,
+    cache_scene_store = 2,
+};
+
+// File layout: a header, a table of sections, then the sections themselves, each starting on a
+// 64-byte boundary so any array type can be used in place. The header records everything the
+// arrays' meaning depends on (format version, byte order, node size) besides the content key.
+struct cache_header
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t kind;
+    uint64_t key;
+    uint32_t byte_order;
+    uint32_t node_size;
+    uint32_t section_count;
+    uint32_t reserved;
+};
+
+struct cache_section
+{
+    uint32_t id;
+    uint32_t element_size;
+    uint64_t offset;
+    uint64_t count;
+};
+
+static const char cache_magic[8] = {'R', 'T', 'C', 'A', 'C', 'H', 'E', '\0'};
+static const uint32_t cache_byte_order = 0x01020304u;
+static const size_t cache_alignment = 64;
+
+// 写缓存文件：先登记各段数据，再一次写出。登记的数组在 write() 之前必须保持有效。
+class cache_writer
+{
+public:
+    cache_writer(cache_kind kind, uint64_t key) : kind(kind), key(key) {}
+
+    template <typename T>
+    void add(uint32_t id, const T *values, size_t count)
+    {
+        sections.push_back(pending_section{id, uint32_t(sizeof(T)), values, count});
+    }
+
+    template <typename T>
+    void add(uint32_t id, const std::vector<T> &values) { add(id, values.data(), values.size()); }
+
+    // Writes to a temporary file and renames it into place, so a reader never maps a half-written
+    // cache; a failed write leaves any previous cache untouched.
+    bool write(const std::string &path) const
+    {
+        std::string temporary = path + ".tmp";
+        {
+            std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+            if (!out)
+                return false;
+
+            cache_header header;
+            std::memcpy(header.magic, cache_magic, sizeof(header.magic));
+            header.version = cache_format_version;
+            header.kind = kind;
+            header.key = key;
+            header.byte_order = cache_byte_order;
+            header.node_size = uint32_t(sizeof(linear_bvh_node));
+            header.section_count = uint32_t(sections.size());
+            header.reserved = 0;
+
+            std::vector<cache_section> table;
+            uint64_t offset = align(sizeof(cache_header) + sections.size() * sizeof(cache_section));
+            for (const auto &s : sections)
+            {
+                table.push_back(cache_section{s.id, s.element_size, offset, s.count});
+                offset = align(offset + s.count * s.element_size);
+            }
+
+            out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+            if (!table.empty())
+                out.write(reinterpret_cast<const char *>(table.data()), table.size() * sizeof(cache_section));
+            uint64_t position = sizeof(header) + table.size() * sizeof(cache_section);
+            static const char zeros[cache_alignment] = {};
+            for (size_t i = 0; i < sections.size(); i++)
+            {
+                out.write(zeros, std::streamsize(table[i].offset - position));
+                out.write(static_cast<const char *>(sections[i].data), std::streamsize(sections[i].count * sections[i].element_size));
+                position = table[i].offset + sections[i].count * sections[i].element_size;
+            }
+            out.close();
+            if (!out)
+            {
+                std::remove(temporary.c_str());
+                return false;
+            }
+        }
+#if defined(_WIN32)
+        std::remove(path.c_str()); // rename() does not replace an existing file on Windows
+#endif
+        if (std::rename(temporary.c_str(), path.c_str()) != 0)
+        {
+            std::remove(temporary.c_str());
+            return false;
+        }
+        return true;
+    }
+
+private:
+    struct pending_section
+    {
+        uint32_t id;
+        uint32_t element_size;
+        const void *data;
+        size_t count;
+    };
+
+    cache_kind kind;
+    uint64_t key;
+    std::vector<pending_section> sections;
+
+    static uint64_t align(uint64_t offset) { return (offset + cache_alignment - 1) & ~uint64_t(cache_alignment - 1); }
+};
+
+// 读缓存文件
+// Maps the file copy-on-write and hands out its sections as arrays in place; nothing is copied or
+// converted. open() fails, and the caller rebuilds, unless the file is intact and matches the
+// expected kind, key, format version, byte order and node size.
+class cache_file
+{
+public:
+    bool open(const std::string &path, cache_kind kind, uint64_t key)
+    {
+        if (!file.open(path, true) || file.size() < sizeof(cache_header))
+            return fail();
+
+        const cache_header &header = *reinterpret_cast<const cache_header *>(file.data());
+        if (std::memcmp(header.magic, cache_magic, sizeof(header.magic)) != 0 || header.version != cache_format_version ||
+            header.kind != kind || header.key != key || header.byte_order != cache_byte_order ||
+            header.node_size != sizeof(linear_bvh_node))
+            return fail();
+
+        uint64_t table_end = sizeof(cache_header) + uint64_t(header.section_count) * sizeof(cache_section);
+        if (table_end > file.size())
+            return fail();
+        const cache_section *table = reinterpret_cast<const cache_section *>(file.data() + sizeof(cache_header));
+        sections.assign(table, table + header.section_count);
+        for (const auto &s : sections)
+        {
+            if (s.offset % cache_alignment != 0 || s.offset > file.size() ||
+                s.count > (file.size() - s.offset) / std::max<uint32_t>(s.element_size, 1))
+                return fail();
+        }
+        return true;
+    }
+
+    // 段 id 中的数组；缺失或元素大小不符时返回 false
+    template <typename T>
+    bool section(uint32_t id, T *&values, size_t &count)
+    {
+        for (const auto &s : sections)
+        {
+            if (s.id != id)
+                continue;
+            if (s.element_size != sizeof(T))
+                return false;
+            values = s.count ? reinterpret_cast<T *>(file.mutable_data() + s.offset) : nullptr;
+            count = size_t(s.count);
+            return true;
+        }
+        return false;
+    }
+
+    // 长度必须正好为 count 的段
+    template <typename T>
+    bool section(uint32_t id, T *&values, size_t expected, bool allow_empty)
+    {
+        size_t count;
+        return section(id, values, count) && (count == expected || (allow_empty && count == 0));
+    }
+
+    size_t size() const { return file.size(); }
+
+private:
+    mapped_file file;
+    std::vector<cache_section> sections;
+
+    bool fail()
+    {
+        file.close();
+        sections.clear();
+        return false;
+    }
+};
+
+#endif
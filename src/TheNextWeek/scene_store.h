@@ -0,0 +1,591 @@
+#ifndef SCENE_STORE_H
+#define SCENE_STORE_H
+
+#include "rtweekend.h"
+#include "arena.h"
+#include "hittable.h"
+#include "material.h"
+#include "sphere.h"
+#include "quad.h"
+#include "bvh_builder.h"
+#include "linear_bvh.h"
+#include "scene_cache.h"
+
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// 面向数据的场景存储
+// Keeps spheres and quads as plain numbers in contiguous structure-of-arrays storage instead of
+// one heap object per primitive: each field of each primitive type is its own array, allocated
+// from a monotonic arena together with the scene's materials and textures. There is no per-
+// primitive vtable pointer, control block or shared_ptr; the whole scene is freed in one step
+// with the store.
+//
+// Primitives are added first and build() then runs the binned SAH builder over all of them and
+// lays the arrays out in leaf order, so a leaf's primitives are adjacent in memory. Traversal only
+// keeps the closest primitive's index; the hit_record is filled in once at the end.
+//
+// Emissive primitives additionally get an ordinary sphere or quad in the arena. It stands in for
+// the primitive in light sampling, and hits on the primitive report it as rec.object.
+//
+// The built arrays and BVH can be cached in a file (see build()); an unchanged scene then uses the
+// mapped file in place and skips the build. Primitives refer to their material by a slot number,
+// so the cache holds no pointers.
+class scene_store : public hittable
+{
+public:
+    scene_store() {}
+
+    // Makes a material, texture or any other object in the store's arena. The shared_ptr does not
+    // own it, so it can be passed to the existing constructors without touching a reference count.
+    template <typename T, typename... Args>
+    shared_ptr<T> make(Args &&...args)
+    {
+        return unowned(memory.create<T>(std::forward<Args>(args)...));
+    }
+
+    void add_sphere(const point3 &center, double radius, shared_ptr<material> mat)
+    {
+        staged_sphere s;
+        s.center = center;
+        s.radius = std::fmax(0, radius);
+        s.mat = std::move(mat);
+        spheres_in.push_back(std::move(s));
+    }
+
+    void add_sphere(const point3 &center1, const point3 &center2, double radius, shared_ptr<material> mat)
+    {
+        add_sphere(center1, radius, std::move(mat));
+        spheres_in.back().motion = center2 - center1;
+        spheres_in.back().moving = true;
+    }
+
+    void add_quad(const point3 &Q, const vec3 &u, const vec3 &v, shared_ptr<material> mat)
+    {
+        staged_quad q;
+        q.Q = Q;
+        q.u = u;
+        q.v = v;
+        q.mat = std::move(mat);
+        quads_in.push_back(std::move(q));
+    }
+
+    // 六个面组成的长方体，与 box() 相同
+    void add_box(const point3 &a, const point3 &b, const shared_ptr<material> &mat)
+    {
+        auto min = point3(std::fmin(a.x(), b.x()), std::fmin(a.y(), b.y()), std::fmin(a.z(), b.z()));
+        auto max = point3(std::fmax(a.x(), b.x()), std::fmax(a.y(), b.y()), std::fmax(a.z(), b.z()));
+
+        auto dx = vec3(max.x() - min.x(), 0, 0);
+        auto dy = vec3(0, max.y() - min.y(), 0);
+        auto dz = vec3(0, 0, max.z() - min.z());
+
+        add_quad(point3(min.x(), min.y(), max.z()), dx, dy, mat);  // front
+        add_quad(point3(max.x(), min.y(), max.z()), -dz, dy, mat); // right
+        add_quad(point3(max.x(), min.y(), min.z()), -dx, dy, mat); // back
+        add_quad(point3(min.x(), min.y(), min.z()), dz, dy, mat);  // left
+        add_quad(point3(min.x(), max.y(), max.z()), dx, -dz, mat); // top
+        add_quad(point3(min.x(), min.y(), min.z()), dx, dz, mat);  // bottom
+    }
+
+    // 构建 BVH 并把图元按叶节点顺序写入 arena；之后不能再添加图元
+    // With a cache_path, the result is saved there, keyed by a hash of every staged primitive and
+    // the build options; building the same primitives again maps that file instead. Materials are
+    // not part of the cache, so the scene code may change them without invalidating it.
+    void build(const bvh_build_options &options = bvh_build_options(), const std::string &cache_path = "")
+    {
+        assign_material_slots();
+        uint64_t key = cache_path.empty() ? 0 : content_key(options);
+        if (cache_path.empty() || !load_cache(cache_path, key))
+        {
+            build_arrays(options);
+            if (!cache_path.empty() && !save_cache(cache_path, key))
+                std::cerr << "WARNING: Could not write scene cache '" << cache_path << "'.\n";
+        }
+        make_emitters();
+
+        std::vector<staged_sphere>().swap(spheres_in);
+        std::vector<staged_quad>().swap(quads_in);
+    }
+
+    bool hit(const ray &r, interval ray_t, hit_record &rec) const override
+    {
+        uint32_t closest = 0;
+        bool hit_anything = nodes.traverse(r, ray_t, [&](uint32_t first, uint32_t count, interval &leaf_t)
+        {
+            bool hit_leaf = false;
+            for (uint32_t i = first; i < first + count; i++)
+            {
+                uint32_t ref = refs[i];
+                real t;
+                bool found = (ref & quad_bit) ? hit_quad(ref & ~quad_bit, r, leaf_t, t)
+                                              : hit_sphere(ref, r, leaf_t, t);
+                if (found)
+                {
+                    leaf_t.max = t;
+                    closest = ref;
+                    hit_leaf = true;
+                }
+            }
+            return hit_leaf;
+        });
+
+        if (!hit_anything)
+            return false;
+        if (closest & quad_bit)
+            set_quad_record(closest & ~quad_bit, r, ray_t.max, rec);
+        else
+            set_sphere_record(closest, r, ray_t.max, rec);
+
+        rec.object = this;
+        if (rec.mat_ptr->is_emissive())
+        {
+            auto found = emitters.find(closest);
+            if (found != emitters.end())
+                rec.object = found->second;
+        }
+        return true;
+    }
+
+    aabb bounding_box() const override { return bbox; }
+
+    void collect_emitters(std::vector<const hittable *> &lights) const override
+    {
+        lights.insert(lights.end(), emitter_list.begin(), emitter_list.end());
+    }
+
+    size_t sphere_count() const { return spheres.count; }
+    size_t quad_count() const { return quads.count; }
+    bool from_cache() const { return cache != nullptr; }
+
+    // 场景占用的内存：arena、映射的缓存文件、BVH 节点和光源表
+    size_t memory_bytes() const
+    {
+        return memory.bytes_reserved() + (cache ? cache->size() : nodes.size() * sizeof(linear_bvh_node)) +
+               emitters.size() * (sizeof(uint32_t) + 4 * sizeof(void *));
+    }
+
+private:
+    static const uint32_t quad_bit = 0x80000000u; // refs: 最高位区分球和四边形，其余位是数组下标
+    static const int quad_field_count = 16;
+
+    // 缓存文件中各段的编号
+    enum section_id : uint32_t
+    {
+        section_nodes = 1,
+        section_refs,
+        section_bounds,
+        section_sphere_fields,                                            // x, y, z, radius, motion_x, motion_y, motion_z
+        section_sphere_materials = section_sphere_fields + 7,
+        section_quad_fields,                                              // 16 个字段，顺序见 quad_fields()
+        section_quad_materials = section_quad_fields + quad_field_count,
+    };
+
+    struct staged_sphere
+    {
+        point3 center;
+        vec3 motion;
+        real radius = 0;
+        bool moving = false;
+        shared_ptr<material> mat;
+        uint32_t slot = 0; // materials 中的下标
+    };
+
+    struct staged_quad
+    {
+        point3 Q;
+        vec3 u, v;
+        shared_ptr<material> mat;
+        uint32_t slot = 0;
+    };
+
+    struct sphere_arrays
+    {
+        real *x = nullptr, *y = nullptr, *z = nullptr, *radius = nullptr;
+        real *motion_x = nullptr, *motion_y = nullptr, *motion_z = nullptr; // 没有运动的球时为空
+        uint32_t *mat = nullptr; // 材质槽位
+        size_t count = 0;
+    };
+
+    struct quad_arrays
+    {
+        real *qx = nullptr, *qy = nullptr, *qz = nullptr;
+        real *ux = nullptr, *uy = nullptr, *uz = nullptr;
+        real *vx = nullptr, *vy = nullptr, *vz = nullptr;
+        real *wx = nullptr, *wy = nullptr, *wz = nullptr;
+        real *nx = nullptr, *ny = nullptr, *nz = nullptr;
+        real *d = nullptr;
+        uint32_t *mat = nullptr;
+        size_t count = 0;
+    };
+
+    arena memory;
+    std::vector<staged_sphere> spheres_in;
+    std::vector<staged_quad> quads_in;
+
+    sphere_arrays spheres;
+    quad_arrays quads;
+    uint32_t *refs = nullptr; // 叶节点顺序
+    linear_bvh nodes;
+    aabb bbox;
+    std::unordered_map<uint32_t, const hittable *> emitters; // ref -> 代替它做光源采样的对象
+    std::vector<const hittable *> emitter_list;              // 同上，按叶节点顺序
+    std::vector<shared_ptr<material>> materials;             // 按首次出现的顺序；也保持 make_shared 的材质存活
+    std::unique_ptr<cache_file> cache;                       // 从缓存读取时，数组都在这个文件中
+
+    // Numbers the materials in the order they first appear, which only depends on the scene code.
+    void assign_material_slots()
+    {
+        std::unordered_map<const material *, uint32_t> slot_of;
+        auto assign = [&](const shared_ptr<material> &mat)
+        {
+            auto found = slot_of.insert(std::make_pair(mat.get(), uint32_t(materials.size())));
+            if (found.second)
+                materials.push_back(mat);
+            return found.first->second;
+        };
+        for (auto &s : spheres_in)
+            s.slot = assign(s.mat);
+        for (auto &q : quads_in)
+            q.slot = assign(q.mat);
+    }
+
+    void build_arrays(const bvh_build_options &options)
+    {
+        size_t sphere_total = spheres_in.size(), total = sphere_total + quads_in.size();
+
+        std::vector<aabb> boxes;
+        boxes.reserve(total);
+        for (const auto &s : spheres_in)
+        {
+            auto rvec = vec3(s.radius, s.radius, s.radius);
+            aabb box(s.center - rvec, s.center + rvec);
+            if (s.moving)
+                box = aabb(box, aabb(s.center + s.motion - rvec, s.center + s.motion + rvec));
+            boxes.push_back(box);
+        }
+        for (const auto &q : quads_in)
+            boxes.push_back(aabb(aabb(q.Q, q.Q + q.u + q.v), aabb(q.Q + q.u, q.Q + q.v)));
+
+        bvh_builder builder(boxes, options);
+        auto root = builder.build();
+        nodes = linear_bvh(*root, builder.node_count());
+        bbox = root->bbox;
+        std::vector<aabb>().swap(boxes);
+
+        allocate_spheres(sphere_total);
+        allocate_quads(quads_in.size());
+        refs = memory.allocate_array<uint32_t>(total);
+
+        size_t sphere_slot = 0, quad_slot = 0;
+        const std::vector<size_t> &order = builder.ordered_indices();
+        for (size_t i = 0; i < total; i++)
+        {
+            size_t index = order[i];
+            if (index < sphere_total)
+            {
+                refs[i] = uint32_t(sphere_slot);
+                store_sphere(sphere_slot++, spheres_in[index]);
+            }
+            else
+            {
+                refs[i] = uint32_t(quad_slot) | quad_bit;
+                store_quad(quad_slot++, quads_in[index - sphere_total]);
+            }
+        }
+    }
+
+    // 缓存的键：所有待构建图元的几何与材质槽位，加上构建参数
+    uint64_t content_key(const bvh_build_options &options) const
+    {
+        content_hasher hasher;
+        hasher.add_value(uint64_t(spheres_in.size()));
+        hasher.add_value(uint64_t(quads_in.size()));
+        for (const auto &s : spheres_in)
+        {
+            double values[7] = {s.center.x(), s.center.y(), s.center.z(), s.radius, s.motion.x(), s.motion.y(), s.motion.z()};
+            hasher.add(values, sizeof(values));
+            hasher.add_value(uint32_t(s.moving));
+            hasher.add_value(s.slot);
+        }
+        for (const auto &q : quads_in)
+        {
+            double values[9] = {q.Q.x(), q.Q.y(), q.Q.z(), q.u.x(), q.u.y(), q.u.z(), q.v.x(), q.v.y(), q.v.z()};
+            hasher.add(values, sizeof(values));
+            hasher.add_value(q.slot);
+        }
+        hasher.add_options(options);
+        return hasher.value();
+    }
+
+    bool save_cache(const std::string &path, uint64_t key) const
+    {
+        double bounds[6] = {bbox.x.min, bbox.x.max, bbox.y.min, bbox.y.max, bbox.z.min, bbox.z.max};
+        size_t n = spheres.count;
+        cache_writer writer(cache_scene_store, key);
+        writer.add(section_nodes, nodes.data(), nodes.size());
+        writer.add(section_refs, refs, n + quads.count);
+        writer.add(section_bounds, bounds, 6);
+        real *const sphere_fields[] = {spheres.x, spheres.y, spheres.z, spheres.radius, spheres.motion_x, spheres.motion_y, spheres.motion_z};
+        for (uint32_t f = 0; f < 7; f++)
+            writer.add(section_sphere_fields + f, sphere_fields[f], sphere_fields[f] ? n : 0);
+        writer.add(section_sphere_materials, spheres.mat, n);
+        quad_arrays q = quads;
+        real **fields[quad_field_count];
+        quad_fields(q, fields);
+        for (uint32_t f = 0; f < quad_field_count; f++)
+            writer.add(section_quad_fields + f, *fields[f], quads.count);
+        writer.add(section_quad_materials, quads.mat, quads.count);
+        return writer.write(path);
+    }
+
+    // Points the arrays into the cache file after range-checking its indices and BVH nodes; on any
+    // mismatch nothing is changed.
+    bool load_cache(const std::string &path, uint64_t key)
+    {
+        std::unique_ptr<cache_file> file(new cache_file());
+        if (!file->open(path, cache_scene_store, key))
+            return false;
+
+        size_t sphere_total = spheres_in.size(), quad_total = quads_in.size(), node_count;
+        sphere_arrays s;
+        quad_arrays q;
+        uint32_t *refs_in;
+        linear_bvh_node *node_data;
+        double *bounds;
+        real **sphere_fields[] = {&s.x, &s.y, &s.z, &s.radius, &s.motion_x, &s.motion_y, &s.motion_z};
+        real **fields[quad_field_count];
+        quad_fields(q, fields);
+
+        bool ok = file->section(section_nodes, node_data, node_count) &&
+                  file->section(section_refs, refs_in, sphere_total + quad_total, false) &&
+                  file->section(section_bounds, bounds, 6, false) &&
+                  file->section(section_sphere_materials, s.mat, sphere_total, false) &&
+                  file->section(section_quad_materials, q.mat, quad_total, false);
+        for (uint32_t f = 0; f < 7 && ok; f++)
+            ok = file->section(section_sphere_fields + f, *sphere_fields[f], sphere_total, f >= 4);
+        for (uint32_t f = 0; f < quad_field_count && ok; f++)
+            ok = file->section(section_quad_fields + f, *fields[f], quad_total, false);
+        if (!ok || !linear_bvh::view(node_data, node_count).valid(sphere_total + quad_total))
+            return false;
+        // 下标来自文件，使用前检查一遍
+        for (size_t i = 0; i < sphere_total + quad_total; i++)
+        {
+            uint32_t slot = refs_in[i] & ~quad_bit;
+            if (slot >= ((refs_in[i] & quad_bit) ? quad_total : sphere_total))
+                return false;
+        }
+        for (size_t i = 0; i < sphere_total; i++)
+            ok = ok && s.mat[i] < materials.size();
+        for (size_t i = 0; i < quad_total; i++)
+            ok = ok && q.mat[i] < materials.size();
+        if (!ok)
+            return false;
+
+        s.count = sphere_total;
+        q.count = quad_total;
+        spheres = s;
+        quads = q;
+        refs = refs_in;
+        nodes = linear_bvh::view(node_data, node_count);
+        bbox = aabb(interval(bounds[0], bounds[1]), interval(bounds[2], bounds[3]), interval(bounds[4], bounds[5]));
+        cache = std::move(file);
+        return true;
+    }
+
+    void allocate_spheres(size_t n)
+    {
+        spheres.count = n;
+        spheres.x = memory.allocate_array<real>(n);
+        spheres.y = memory.allocate_array<real>(n);
+        spheres.z = memory.allocate_array<real>(n);
+        spheres.radius = memory.allocate_array<real>(n);
+        bool any_moving = false;
+        for (const auto &s : spheres_in)
+            any_moving = any_moving || s.moving;
+        if (any_moving)
+        {
+            spheres.motion_x = memory.allocate_array<real>(n);
+            spheres.motion_y = memory.allocate_array<real>(n);
+            spheres.motion_z = memory.allocate_array<real>(n);
+        }
+        spheres.mat = memory.allocate_array<uint32_t>(n);
+    }
+
+    void allocate_quads(size_t n)
+    {
+        quads.count = n;
+        real **fields[quad_field_count];
+        quad_fields(quads, fields);
+        for (auto field : fields)
+            *field = memory.allocate_array<real>(n);
+        quads.mat = memory.allocate_array<uint32_t>(n);
+    }
+
+    static void quad_fields(quad_arrays &q, real **fields[quad_field_count])
+    {
+        real **all[quad_field_count] = {&q.qx, &q.qy, &q.qz, &q.ux, &q.uy, &q.uz, &q.vx, &q.vy, &q.vz,
+                                          &q.wx, &q.wy, &q.wz, &q.nx, &q.ny, &q.nz, &q.d};
+        std::copy(all, all + quad_field_count, fields);
+    }
+
+    void store_sphere(size_t i, const staged_sphere &s)
+    {
+        put(spheres.x, spheres.y, spheres.z, i, s.center);
+        spheres.radius[i] = s.radius;
+        if (spheres.motion_x)
+            put(spheres.motion_x, spheres.motion_y, spheres.motion_z, i, s.motion);
+        spheres.mat[i] = s.slot;
+    }
+
+    void store_quad(size_t i, const staged_quad &q)
+    {
+        vec3 n = cross(q.u, q.v);
+        vec3 normal = unit_vector(n);
+        vec3 w = n / dot(n, n);
+        put(quads.qx, quads.qy, quads.qz, i, q.Q);
+        put(quads.ux, quads.uy, quads.uz, i, q.u);
+        put(quads.vx, quads.vy, quads.vz, i, q.v);
+        put(quads.wx, quads.wy, quads.wz, i, w);
+        put(quads.nx, quads.ny, quads.nz, i, normal);
+        quads.d[i] = dot(normal, q.Q);
+        quads.mat[i] = q.slot;
+    }
+
+    // Proxies for light sampling, in leaf order. Spheres in motion have none.
+    void make_emitters()
+    {
+        for (size_t i = 0; i < spheres.count + quads.count; i++)
+        {
+            uint32_t ref = refs[i];
+            const hittable *proxy = nullptr;
+            if (ref & quad_bit)
+            {
+                uint32_t k = ref & ~quad_bit;
+                const shared_ptr<material> &mat = materials[quads.mat[k]];
+                if (mat->is_emissive())
+                    proxy = memory.create<quad>(point3(quads.qx[k], quads.qy[k], quads.qz[k]), vec3(quads.ux[k], quads.uy[k], quads.uz[k]),
+                                                vec3(quads.vx[k], quads.vy[k], quads.vz[k]), mat);
+            }
+            else
+            {
+                const shared_ptr<material> &mat = materials[spheres.mat[ref]];
+                bool moving = spheres.motion_x && (spheres.motion_x[ref] != 0 || spheres.motion_y[ref] != 0 || spheres.motion_z[ref] != 0);
+                if (!moving && mat->is_emissive())
+                    proxy = memory.create<sphere>(point3(spheres.x[ref], spheres.y[ref], spheres.z[ref]), spheres.radius[ref], mat);
+            }
+            if (proxy)
+            {
+                emitters[ref] = proxy;
+                emitter_list.push_back(proxy);
+            }
+        }
+    }
+
+    static void put(real *x, real *y, real *z, size_t i, const vec3 &value)
+    {
+        x[i] = value.x();
+        y[i] = value.y();
+        z[i] = value.z();
+    }
+
+    point3 sphere_center(uint32_t i, double time) const
+    {
+        point3 center(spheres.x[i], spheres.y[i], spheres.z[i]);
+        if (spheres.motion_x)
+            center += vec3(spheres.motion_x[i], spheres.motion_y[i], spheres.motion_z[i]) * time;
+        return center;
+    }
+
+    // 与 sphere::hit() 相同的运算
+    bool hit_sphere(uint32_t i, const ray &r, const interval &ray_t, real &t) const
+    {
+        RT_STAT(thread_stats().primitive_tests++);
+        vec3 oc = sphere_center(i, r.get_time()) - r.origin();
+        real radius = spheres.radius[i];
+        auto a = r.direction().length_squared();
+        auto h = dot(r.direction(), oc);
+        auto c = oc.length_squared() - radius * radius;
+
+        auto discriminant = h * h - a * c;
+        if (discriminant < 0)
+            return false;
+
+        auto sqrtd = std::sqrt(discriminant);
+        t = (h - sqrtd) / a;
+        if (!ray_t.surrounds(t))
+        {
+            t = (h + sqrtd) / a;
+            if (!ray_t.surrounds(t))
+                return false;
+        }
+        return true;
+    }
+
+    // 与 quad::hit() 相同的运算
+    bool hit_quad(uint32_t i, const ray &r, const interval &ray_t, real &t) const
+    {
+        RT_STAT(thread_stats().primitive_tests++);
+        real alpha, beta;
+        if (!quad_plane(i, r, t, alpha, beta) || !ray_t.surrounds(t))
+            return false;
+        return alpha >= 0 && alpha <= 1 && beta >= 0 && beta <= 1;
+    }
+
+    bool quad_plane(uint32_t i, const ray &r, real &t, real &alpha, real &beta) const
+    {
+        vec3 normal(quads.nx[i], quads.ny[i], quads.nz[i]);
+        auto denom = dot(normal, r.direction());
+        if (std::fabs(denom) < real(1e-8))
+            return false;
+
+        t = (quads.d[i] - dot(normal, r.origin())) / denom;
+        vec3 p = r.at(t) - point3(quads.qx[i], quads.qy[i], quads.qz[i]);
+        vec3 u(quads.ux[i], quads.uy[i], quads.uz[i]);
+        vec3 v(quads.vx[i], quads.vy[i], quads.vz[i]);
+        vec3 w(quads.wx[i], quads.wy[i], quads.wz[i]);
+        alpha = dot(w, cross(p, v));
+        beta = dot(w, cross(u, p));
+        return true;
+    }
+
+    void set_sphere_record(uint32_t i, const ray &r, real t, hit_record &rec) const
+    {
+        point3 center = sphere_center(i, r.get_time());
+        real radius = spheres.radius[i];
+        rec.t = t;
+        // 与 sphere 相同：投影回球面，给出误差界
+        vec3 offset = r.at(t) - center;
+        offset *= radius / offset.length();
+        rec.p = center + offset;
+        rec.p_error = error_gamma(6) * (abs(center) + abs(offset));
+        vec3 outward_normal = offset / radius;
+        rec.set_face_normal(r, outward_normal);
+        sphere::get_sphere_uv(outward_normal, rec.u, rec.v);
+        rec.mat_ptr = materials[spheres.mat[i]].get();
+    }
+
+    void set_quad_record(uint32_t i, const ray &r, real t, hit_record &rec) const
+    {
+        // hit_quad 已经接受了这个四边形，quad_plane 在这里必然成功
+        real plane_t = t, alpha = 0, beta = 0;
+        quad_plane(i, r, plane_t, alpha, beta);
+        // 与 quad 相同：由平面坐标重建交点
+        vec3 along_u = alpha * vec3(quads.ux[i], quads.uy[i], quads.uz[i]);
+        vec3 along_v = beta * vec3(quads.vx[i], quads.vy[i], quads.vz[i]);
+        point3 Q(quads.qx[i], quads.qy[i], quads.qz[i]);
+        rec.t = t;
+        rec.u = alpha;
+        rec.v = beta;
+        rec.p = Q + along_u + along_v;
+        rec.p_error = error_gamma(7) * (abs(Q) + abs(along_u) + abs(along_v));
+        rec.mat_ptr = materials[quads.mat[i]].get();
+        rec.set_face_normal(r, vec3(quads.nx[i], quads.ny[i], quads.nz[i]));
+    }
+};
+
+#endif
@@ -0,0 +1,470 @@
+#ifndef SCENES_H
+#define SCENES_H
+
+#include "rtweekend.h"
+#include "camera.h"
+#include "hittable.h"
+#include "hittable_list.h"
+#include "material.h"
+#include "sphere.h"
+#include "bvh.h"
+#include "wide_bvh.h"
+#include "texture.h"
+#include "quad.h"
+#include "scene_store.h"
+#include "instance.h"
+#include "triangle_mesh.h"
+#include "mesh_loader.h"
+
+#include <cctype>
+#include <chrono>
+#include <map>
+#include <string>
+#include <vector>
+
+// 场景：几何体（已经建好加速结构）和默认视角。渲染任务在默认视角上覆盖自己的设置
+struct scene
+{
+    shared_ptr<hittable> world;
+    camera_settings view;
+};
+
+// 场景之间共享的资源，按文件名只加载一次
+class scene_resources
+{
+public:
+    shared_ptr<const rtw_image> image(const std::string &filename)
+    {
+        auto &entry = images[filename];
+        if (!entry)
+            entry = make_shared<rtw_image>(filename.c_str());
+        return entry;
+    }
+
+private:
+    std::map<std::string, shared_ptr<const rtw_image>> images;
+};
+
+inline shared_ptr<scene> quads(scene_resources &resources)
+{
+    hittable_list world;
+
+    // Materials
+    auto left_red = make_shared<lambertian>(color(1.0, 0.2, 0.2));
+    auto back_green = make_shared<lambertian>(color(0.2, 1.0, 0.2));
+    auto right_blue = make_shared<lambertian>(color(0.2, 0.2, 1.0));
+    auto upper_orange = make_shared<lambertian>(color(1.0, 0.5, 0.0));
+    auto lower_teal = make_shared<lambertian>(color(0.2, 0.8, 0.8));
+
+    // Quads
+    world.add(make_shared<quad>(point3(-3, -2, 5), vec3(0, 0, -4), vec3(0, 4, 0), left_red));
+    world.add(make_shared<quad>(point3(-2, -2, 0), vec3(4, 0, 0), vec3(0, 4, 0), back_green));
+    world.add(make_shared<quad>(point3(3, -2, 1), vec3(0, 0, 4), vec3(0, 4, 0), right_blue));
+    world.add(make_shared<quad>(point3(-2, 3, 1), vec3(4, 0, 0), vec3(0, 0, 4), upper_orange));
+    world.add(make_shared<quad>(point3(-2, -3, 5), vec3(4, 0, 0), vec3(0, 0, -4), lower_teal));
+
+    auto result = make_shared<scene>();
+    camera_settings &cam = result->view;
+
+    cam.aspect_ratio = 1.0;
+    cam.image_width = 400;
+    cam.samples_per_pixel = 100;
+    cam.max_depth = 50;
+
+    cam.vfov = 80;
+    cam.lookfrom = point3(0, 0, 9);
+    cam.lookat = point3(0, 0, 0);
+    cam.vup = vec3(0, 1, 0);
+    cam.background = color(0.70, 0.80, 1.00);
+
+    result->world = make_shared<hittable_list>(world);
+    return result;
+}
+
+inline shared_ptr<scene> perlin_spheres(scene_resources &resources)
+{
+    hittable_list world;
+
+    auto pertext = make_shared<noise_texture>(4);
+    world.add(make_shared<sphere>(point3(0, -1000, 0), 1000, make_shared<lambertian>(pertext)));
+    world.add(make_shared<sphere>(point3(0, 2, 0), 2, make_shared<lambertian>(pertext)));
+
+    auto result = make_shared<scene>();
+    camera_settings &cam = result->view;
+
+    cam.aspect_ratio = 16.0 / 9.0;
+    cam.image_width = 1200;
+    cam.samples_per_pixel = 100;
+    cam.max_depth = 50;
+
+    cam.vfov = 20;
+    cam.lookfrom = point3(13, 2, 3);
+    cam.lookat = point3(0, 0, 0);
+    cam.vup = vec3(0, 1, 0);
+    cam.background = color(0.70, 0.80, 1.00);
+    result->world = make_shared<hittable_list>(world);
+    return result;
+}
+
+inline shared_ptr<scene> earth(scene_resources &resources)
+{
+    auto earth_texture = make_shared<image_texture>(resources.image("earthmap.jpg"));
+    auto earth_surface = make_shared<lambertian>(earth_texture);
+    auto globe = make_shared<sphere>(point3(0, 0, 0), 2, earth_surface);
+
+    auto result = make_shared<scene>();
+    camera_settings &cam = result->view;
+
+    cam.aspect_ratio = 16.0 / 9.0;
+    cam.image_width = 400;
+    cam.samples_per_pixel = 100;
+    cam.max_depth = 50;
+
+    cam.vfov = 20;
+    cam.lookfrom = point3(0, 0, 12);
+    cam.lookat = point3(0, 0, 0);
+    cam.vup = vec3(0, 1, 0);
+    cam.background = color(0.70, 0.80, 1.00);
+    result->world = make_shared<hittable_list>(globe);
+    return result;
+}
+
+inline shared_ptr<scene> checkered_spheres(scene_resources &resources)
+{
+    hittable_list world;
+
+    auto checker = make_shared<checker_texture>(0.32, color(.2, .3, .1), color(.9, .9, .9));
+    world.add(make_shared<sphere>(point3(0, -1000, 0), 1000, make_shared<lambertian>(checker)));
+
+    for (int a = -11; a < 11; a++)
+    {
+        for (int b = -11; b < 11; b++)
+        {
+            auto choose_mat = random_double();
+            point3 center(a + 0.9 * random_double(), 0.2, b + 0.9 * random_double());
+
+            if ((center - point3(4, 0.2, 0)).length() > 0.9)
+            {
+                shared_ptr<material> sphere_material;
+
+                if (choose_mat < 0.8)
+                {
+                    // diffuse
+                    auto albedo = color::random() * color::random();
+                    sphere_material = make_shared<lambertian>(albedo);
+                    auto center2 = center + vec3(0, random_double(0.0, 0.1), 0);
+                    world.add(make_shared<sphere>(center, center2, 0.2, sphere_material));
+                }
+                else if (choose_mat < 0.95)
+                {
+                    // 金属材质
+                    auto albedo = color::random(0.5, 1);
+                    auto fuzz = random_double(0, 0.5);
+                    sphere_material = make_shared<metal>(albedo, fuzz);
+                    world.add(make_shared<sphere>(center, 0.2, sphere_material));
+                }
+                else
+                {
+                    // 玻璃材质
+                    sphere_material = make_shared<dielectric>(1.5);
+                    world.add(make_shared<sphere>(center, 0.2, sphere_material));
+                }
+            }
+        }
+    }
+
+    // 添加三个特殊材质的球体
+    auto material1 = make_shared<dielectric>(1.5);
+    world.add(make_shared<sphere>(point3(0, 1, 0), 1.0, material1));
+
+    auto material2 = make_shared<lambertian>(color(0.4, 0.2, 0.1));
+    world.add(make_shared<sphere>(point3(-4, 1, 0), 1.0, material2));
+
+    auto material3 = make_shared<metal>(color(0.7, 0.6, 0.5), 0.0);
+    world.add(make_shared<sphere>(point3(4, 1, 0), 1.0, material3));
+
+    world = hittable_list(make_shared<bvh4>(world));
+
+    // 设置相机参数
+    auto result = make_shared<scene>();
+    camera_settings &cam = result->view;
+
+    cam.aspect_ratio = 16.0 / 9.0;
+    cam.image_width = 720;
+    cam.samples_per_pixel = 100;
+    cam.max_depth = 20;
+
+    cam.vfov = 20;
+    cam.lookfrom = point3(13, 2, 3);
+    cam.lookat = point3(0, 0, 0);
+    cam.vup = vec3(0, 1, 0);
+    cam.background = color(0.70, 0.80, 1.00);
+    // 渲染场景
+    result->world = make_shared<hittable_list>(world);
+    return result;
+}
+
+inline shared_ptr<scene> simple_light(scene_resources &resources)
+{
+    hittable_list world;
+
+    auto pertext = make_shared<noise_texture>(4);
+    world.add(make_shared<sphere>(point3(0, -1000, 0), 1000, make_shared<lambertian>(pertext)));
+    world.add(make_shared<sphere>(point3(0, 2, 0), 2, make_shared<lambertian>(pertext)));
+
+    auto difflight = make_shared<diffuse_light>(color(4, 4, 4));
+    world.add(make_shared<quad>(point3(3, 1, -2), vec3(2, 0, 0), vec3(0, 2, 0), difflight));
+    world.add(make_shared<sphere>(point3(0, 7, 0), 2, difflight));
+    auto result = make_shared<scene>();
+    camera_settings &cam = result->view;
+
+    cam.aspect_ratio = 16.0 / 9.0;
+    cam.image_width = 1600;
+    cam.samples_per_pixel = 200;
+    cam.max_depth = 50;
+    cam.background = color(0, 0, 0);
+
+    cam.vfov = 20;
+    cam.lookfrom = point3(26, 3, 6);
+    cam.lookat = point3(0, 2, 0);
+    cam.vup = vec3(0, 1, 0);
+
+    result->world = make_shared<hittable_list>(world);
+    return result;
+}
+
+inline shared_ptr<scene> cornell_box(scene_resources &resources)
+{
+    hittable_list world;
+
+    auto red = make_shared<lambertian>(color(.65, .05, .05));
+    auto white = make_shared<lambertian>(color(.73, .73, .73));
+    auto green = make_shared<lambertian>(color(.05, .85, .05));
+    auto light = make_shared<diffuse_light>(color(10, 10, 10));
+
+    world.add(make_shared<quad>(point3(555, 0, 0), vec3(0, 555, 0), vec3(0, 0, 555), green));
+    world.add(make_shared<quad>(point3(0, 0, 0), vec3(0, 555, 0), vec3(0, 0, 555), red));
+    world.add(make_shared<quad>(point3(343, 554, 332), vec3(-130, 0, 0), vec3(0, 0, -105), light));
+    world.add(make_shared<quad>(point3(0, 0, 0), vec3(555, 0, 0), vec3(0, 0, 555), white));
+    world.add(make_shared<quad>(point3(555, 555, 555), vec3(-555, 0, 0), vec3(0, 0, -555), white));
+    world.add(make_shared<quad>(point3(0, 0, 555), vec3(555, 0, 0), vec3(0, 555, 0), white));
+
+    shared_ptr<hittable> box1 = box(point3(0, 0, 0), point3(165, 330, 165), white);
+    box1 = make_shared<rotate_y>(box1, 15);
+    box1 = make_shared<translate>(box1, vec3(265, 0, 295));
+    world.add(box1);
+
+    shared_ptr<hittable> box2 = box(point3(0, 0, 0), point3(165, 165, 165), white);
+    box2 = make_shared<rotate_y>(box2, -18);
+    box2 = make_shared<translate>(box2, vec3(130, 0, 65));
+    world.add(box2);
+
+    // test
+    // world.add(make_shared<sphere>(point3(295, 165, 230), 20.0, light));
+
+    world = hittable_list(make_shared<BVHNode>(world));
+
+    auto result = make_shared<scene>();
+    camera_settings &cam = result->view;
+
+    cam.aspect_ratio = 1.0;
+    cam.image_width = 960;
+    cam.samples_per_pixel = 500;
+    cam.max_depth = 50;
+    cam.background = color(0, 0, 0);
+
+    cam.vfov = 40;
+    cam.lookfrom = point3(278, 278, -800);
+    cam.lookat = point3(278, 278, 0);
+    cam.vup = vec3(0, 1, 0);
+
+    result->world = make_shared<hittable_list>(world);
+    return result;
+}
+
+// 一百万个小球，存放在 scene_store 中：图元、材质和纹理都在同一个 arena 里；构建结果缓存在当前目录
+inline shared_ptr<scene> sphere_field(scene_resources &resources)
+{
+    auto start = std::chrono::steady_clock::now();
+    auto world = make_shared<scene_store>();
+
+    std::vector<shared_ptr<material>> palette;
+    for (int k = 0; k < 16; k++)
+        palette.push_back(world->make<lambertian>(world->make<solid_color>(color::random(0.1, 0.9))));
+    auto ground = world->make<lambertian>(world->make<checker_texture>(2.0, color(.2, .3, .1), color(.9, .9, .9)));
+
+    const int n = 1000;
+    world->add_quad(point3(-n, 0, -n), vec3(2 * n, 0, 0), vec3(0, 0, 2 * n), ground);
+    for (int a = 0; a < n; a++)
+    {
+        for (int b = 0; b < n; b++)
+        {
+            point3 center(a - n / 2 + 0.8 * random_double(), 0.2, b - n / 2 + 0.8 * random_double());
+            world->add_sphere(center, 0.2, palette[random_int(0, 15)]);
+        }
+    }
+    world->build(bvh_build_options(), "sphere_field.rtcache");
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::clog << (world->from_cache() ? "Mapped " : "Built ") << world->sphere_count() << " spheres in " << seconds << " s, "
+              << world->memory_bytes() / (1024 * 1024) << " MiB\n";
+
+    auto result = make_shared<scene>();
+    camera_settings &cam = result->view;
+
+    cam.aspect_ratio = 16.0 / 9.0;
+    cam.image_width = 720;
+    cam.samples_per_pixel = 64;
+    cam.max_depth = 20;
+
+    cam.vfov = 30;
+    cam.lookfrom = point3(0, 8, 30);
+    cam.lookat = point3(0, 0, 0);
+    cam.vup = vec3(0, 1, 0);
+    cam.background = color(0.70, 0.80, 1.00);
+
+    result->world = world;
+    return result;
+}
+
+// 两级加速结构：一万个实例共享同一个长方体的 BVH，每个实例只多一个变换矩阵
+inline shared_ptr<scene> box_instances(scene_resources &resources)
+{
+    hittable_list boxes;
+
+    auto white = make_shared<lambertian>(color(.73, .73, .73));
+    auto ground = make_shared<lambertian>(make_shared<checker_texture>(1.0, color(.2, .3, .1), color(.9, .9, .9)));
+    auto shared_box = make_shared<BVHNode>(*box(point3(-0.5, -0.5, -0.5), point3(0.5, 0.5, 0.5), white));
+
+    for (int a = -50; a < 50; a++)
+    {
+        for (int b = -50; b < 50; b++)
+        {
+            double size = random_double(0.1, 0.4);
+            auto to_world = affine_transform::translation(vec3(a + 0.5, size / 2, b + 0.5)) *
+                            affine_transform::rotation(vec3(random_double(-0.2, 0.2), 1, random_double(-0.2, 0.2)), random_double(0, 90)) *
+                            affine_transform::scaling(vec3(size, size * random_double(0.5, 3), size));
+            boxes.add(make_shared<instance>(shared_box, to_world));
+        }
+    }
+
+    hittable_list world;
+    world.add(make_shared<BVHNode>(boxes));
+    world.add(make_shared<quad>(point3(-60, 0, -60), vec3(120, 0, 0), vec3(0, 0, 120), ground));
+
+    auto result = make_shared<scene>();
+    camera_settings &cam = result->view;
+
+    cam.aspect_ratio = 16.0 / 9.0;
+    cam.image_width = 720;
+    cam.samples_per_pixel = 64;
+    cam.max_depth = 20;
+
+    cam.vfov = 30;
+    cam.lookfrom = point3(0, 6, 25);
+    cam.lookat = point3(0, 0, 0);
+    cam.vup = vec3(0, 1, 0);
+    cam.background = color(0.70, 0.80, 1.00);
+
+    result->world = make_shared<hittable_list>(world);
+    return result;
+}
+
+// 从 OBJ 或 PLY 文件读取的三角网格，缩放到单位大小后放在地面上。构建好的网格缓存在模型旁边，
+// 模型不变时下次直接映射缓存文件
+inline shared_ptr<scene> triangle_model(const std::string &path, scene_resources &resources)
+{
+    auto start = std::chrono::steady_clock::now();
+    auto model = load_mesh_cached(path, make_shared<lambertian>(color(.73, .73, .73)));
+    if (!model)
+        return nullptr;
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::clog << (model->from_cache() ? "Mapped " : "Loaded and built ") << model->triangle_count() << " triangles in "
+              << seconds << " s, " << model->memory_bytes() / (1024 * 1024) << " MiB\n";
+
+    // 最长边缩放到 2，底面放在 y = 0
+    aabb box = model->bounding_box();
+    double size = std::fmax(box.x.size(), std::fmax(box.y.size(), box.z.size()));
+    point3 center(0.5 * (box.x.min + box.x.max), box.y.min, 0.5 * (box.z.min + box.z.max));
+    auto to_world = affine_transform::scaling(vec3(2 / size, 2 / size, 2 / size)) * affine_transform::translation(-center);
+
+    hittable_list world;
+    auto ground = make_shared<lambertian>(make_shared<checker_texture>(0.5, color(.2, .3, .1), color(.9, .9, .9)));
+    world.add(make_shared<instance>(model, to_world));
+    world.add(make_shared<quad>(point3(-20, 0, -20), vec3(40, 0, 0), vec3(0, 0, 40), ground));
+    world.add(make_shared<quad>(point3(-1, 5, -1), vec3(2, 0, 0), vec3(0, 0, 2), make_shared<diffuse_light>(color(15, 15, 15))));
+
+    auto result = make_shared<scene>();
+    camera_settings &cam = result->view;
+
+    cam.aspect_ratio = 16.0 / 9.0;
+    cam.image_width = 720;
+    cam.samples_per_pixel = 64;
+    cam.max_depth = 20;
+
+    cam.vfov = 30;
+    cam.lookfrom = point3(0, 2.5, 7);
+    cam.lookat = point3(0, 1, 0);
+    cam.vup = vec3(0, 1, 0);
+    cam.background = color(0.20, 0.25, 0.30);
+
+    result->world = make_shared<hittable_list>(world);
+    return result;
+}
+
+typedef shared_ptr<scene> (*scene_builder)(scene_resources &);
+
+struct named_scene
+{
+    const char *name;
+    scene_builder build;
+};
+
+// 内置场景
+inline const std::vector<named_scene> &builtin_scenes()
+{
+    static const std::vector<named_scene> scenes = {
+        {"checkered_spheres", checkered_spheres},
+        {"earth", earth},
+        {"perlin_spheres", perlin_spheres},
+        {"quads", quads},
+        {"simple_light", simple_light},
+        {"cornell_box", cornell_box},
+        {"sphere_field", sphere_field},
+        {"box_instances", box_instances},
+    };
+    return scenes;
+}
+
+// 按名称构建场景：内置场景的名字，或者一个 .obj/.ply 模型文件（用 triangle_model 摆放）。
+// 名字无法识别或模型无法加载时返回 nullptr
+inline shared_ptr<scene> make_scene(const std::string &name, scene_resources &resources)
+{
+    auto named = [&name](shared_ptr<scene> built)
+    {
+        if (built)
+            built->view.scene_name = name;
+        return built;
+    };
+
+    for (const auto &entry : builtin_scenes())
+    {
+        if (name == entry.name)
+            return named(entry.build(resources));
+    }
+
+    auto dot = name.find_last_of('.');
+    std::string ext = (dot == std::string::npos) ? "" : name.substr(dot + 1);
+    for (auto &ch : ext)
+        ch = char(std::tolower((unsigned char)ch));
+    if (ext == "obj" || ext == "ply")
+        return named(triangle_model(name, resources));
+
+    std::cerr << "ERROR: Unknown scene '" << name << "'. Scenes are";
+    for (const auto &entry : builtin_scenes())
+        std::cerr << ' ' << entry.name;
+    std::cerr << ", or an .obj/.ply model file.\n";
+    return nullptr;
+}
+
+#endif
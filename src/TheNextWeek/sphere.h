@@ -2,6 +2,7 @@
 #define SPHERE_H
 #include "rtweekend.h"
 #include "hittable.h"
+#include "material.h"
 
 // 在此处添加注释
 class sphere : public hittable
@@ -27,6 +28,7 @@ public:
     // 计算 ray 与球相交的函数
     bool hit(const ray &r, interval ray_t, hit_record &rec) const override
     {
+        RT_STAT(thread_stats().primitive_tests++);
         point3 center = is_moving ? shpere_center(r.get_time()) : center1;
         vec3 oc = center - r.origin();
         auto a = r.direction().length_squared();
@@ -47,28 +49,118 @@ public:
                 return false;
         }
 
-        rec.t = root;
-        rec.p = r.at(rec.t);
-        vec3 outward_normal = (rec.p - center) / radius;
-        rec.set_face_normal(r, outward_normal);
-        get_sphere_uv(outward_normal, rec.u, rec.v);
-        rec.mat_ptr = mat;
+        set_hit_record(r, root, center, rec);
         return true;
     }
 
-    aabb bounding_box() const override { return boundingBox; }
+    // 光线包求交：判别式按通道以 SoA 方式计算，只有判别式非负的通道才求根并填写 hit_record
+    void hit_packet(ray_packet &packet, unsigned lanes, packet_hit &hits) const override
+    {
+        RT_STAT(thread_stats().primitive_tests += lane_count(lanes));
+        const int n = ray_packet::max_size;
+        real hs[n], as[n], discriminants[n];
+        real rr = radius * radius;
+        real move = is_moving ? 1 : 0;
 
-private:
-    point3 center1;
-    double radius;
-    bool is_moving;
-    vec3 center_vec;
-    aabb boundingBox;
-    shared_ptr<material> mat;
-    point3 shpere_center(double time) const
+        // Branch-free so it vectorizes
+        for (int k = 0; k < n; k++)
+        {
+            real time = real(packet.time[k]);
+            real cx = move != 0 ? center1.x() + time * center_vec.x() : center1.x();
+            real cy = move != 0 ? center1.y() + time * center_vec.y() : center1.y();
+            real cz = move != 0 ? center1.z() + time * center_vec.z() : center1.z();
+            real ocx = cx - packet.org_x[k], ocy = cy - packet.org_y[k], ocz = cz - packet.org_z[k];
+            real a = packet.dir_x[k] * packet.dir_x[k] + packet.dir_y[k] * packet.dir_y[k] + packet.dir_z[k] * packet.dir_z[k];
+            real h = packet.dir_x[k] * ocx + packet.dir_y[k] * ocy + packet.dir_z[k] * ocz;
+            real c = (ocx * ocx + ocy * ocy + ocz * ocz) - rr;
+
+            hs[k] = h;
+            as[k] = a;
+            discriminants[k] = h * h - a * c;
+        }
+
+        for (; lanes; lanes &= lanes - 1)
+        {
+            int k = lowest_lane(lanes);
+            if (discriminants[k] < 0)
+                continue;
+
+            interval ray_t(packet.t_min, packet.t_max[k]);
+            real sqrtd = sqrt(discriminants[k]);
+            real root = (hs[k] - sqrtd) / as[k];
+            if (!ray_t.surrounds(root))
+            {
+                root = (hs[k] + sqrtd) / as[k];
+                if (!ray_t.surrounds(root))
+                    continue;
+            }
+
+            const ray &r = packet.rays[k];
+            set_hit_record(r, root, is_moving ? shpere_center(r.get_time()) : center1, hits.rec[k]);
+            packet.t_max[k] = root;
+            hits.mask |= 1u << k;
+        }
+    }
+
+    // 在 origin 看到的球冠锥内均匀采样方向：pdf = 1 / (2 pi (1 - cos_theta_max))。
+    // origin 在球内时无法这样采样，pdf 为 0。
+    double pdf_value(const point3 &origin, const vec3 &direction) const override
     {
-        return center1 + (center_vec * time);
+        hit_record rec;
+        if (!this->hit(ray(origin, direction), interval(0, infinity), rec))
+            return 0;
+
+        auto distance_squared = (center1 - origin).length_squared();
+        if (distance_squared <= radius * radius)
+            return 0;
+        auto cos_theta_max = std::sqrt(1 - radius * radius / distance_squared);
+        auto solid_angle = 2 * pi * (1 - cos_theta_max);
+        return 1 / solid_angle;
     }
+
+    vec3 random(const point3 &origin) const override
+    {
+        vec3 direction = center1 - origin;
+        auto distance_squared = direction.length_squared();
+        if (distance_squared <= radius * radius)
+            return direction;
+
+        // Uniform direction in the cone around w that the sphere subtends.
+        auto r1 = random_double();
+        auto r2 = random_double();
+        auto z = 1 + r2 * (std::sqrt(1 - radius * radius / distance_squared) - 1);
+        auto phi = 2 * pi * r1;
+        auto x = std::cos(phi) * std::sqrt(1 - z * z);
+        auto y = std::sin(phi) * std::sqrt(1 - z * z);
+
+        vec3 w = unit_vector(direction);
+        vec3 a = (std::fabs(w.x()) > 0.9) ? vec3(0, 1, 0) : vec3(1, 0, 0);
+        vec3 v = unit_vector(cross(w, a));
+        vec3 u = cross(w, v);
+        return x * u + y * v + z * w;
+    }
+
+    // 运动的球随时间移动，无法按位置采样，不作为可采样光源
+    void collect_emitters(std::vector<const hittable *> &emitters) const override
+    {
+        if (!is_moving && mat->is_emissive())
+            emitters.push_back(this);
+    }
+
+    // 功率按 (u, v) = (0.5, 0.5) 处的亮度估计；法线覆盖所有方向
+    light_bounds emitter_bounds() const override
+    {
+        light_bounds lb;
+        color L = mat->emitted(0.5, 0.5, center1 + vec3(-radius, 0, 0));
+        lb.bounds = boundingBox;
+        lb.phi = pi * 4 * pi * radius * radius * luminance(L);
+        lb.cos_theta_o = -1;
+        lb.cos_theta_e = 0;
+        return lb;
+    }
+
+    aabb bounding_box() const override { return boundingBox; }
+
     static void get_sphere_uv(const point3 &p, double &u, double &v)
     {
         // p: a given point on the sphere of radius one, centered at the origin.
@@ -84,6 +176,33 @@ private:
         u = phi / (2 * pi);
         v = theta / pi;
     }
+
+private:
+    point3 center1;
+    real radius;
+    bool is_moving;
+    vec3 center_vec;
+    aabb boundingBox;
+    shared_ptr<material> mat;
+    point3 shpere_center(double time) const
+    {
+        return center1 + (center_vec * time);
+    }
+    void set_hit_record(const ray &r, real root, const point3 &center, hit_record &rec) const
+    {
+        rec.t = root;
+        // r.at(t) carries the error of the root, which grows with the distance along the ray.
+        // Projecting it back onto the sphere leaves only the rounding of the projection itself.
+        vec3 offset = r.at(rec.t) - center;
+        offset *= radius / offset.length();
+        rec.p = center + offset;
+        rec.p_error = error_gamma(6) * (abs(center) + abs(offset));
+        vec3 outward_normal = offset / radius;
+        rec.set_face_normal(r, outward_normal);
+        get_sphere_uv(outward_normal, rec.u, rec.v);
+        rec.mat_ptr = mat.get();
+        rec.object = this;
+    }
 };
 
 #endif
\ No newline at end of file
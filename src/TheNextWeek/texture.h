@@ -62,28 +62,31 @@ private:
 class image_texture : public texture
 {
 public:
-    image_texture(const char *filename) : image(filename) {}
+    image_texture(const char *filename) : image(make_shared<rtw_image>(filename)) {}
+
+    // 共享已经加载的图像，多个纹理或多个场景只解码一次
+    image_texture(shared_ptr<const rtw_image> image) : image(image) {}
 
     color value(double u, double v, const point3 &p) const override
     {
         // If we have no texture data, then return solid cyan as a debugging aid.
-        if (image.height() <= 0)
+        if (image->height() <= 0)
             return color(0, 1, 1);
 
         // Clamp input texture coordinates to [0,1] x [1,0]
         u = interval(0, 1).clamp(u);
         v = 1.0 - interval(0, 1).clamp(v); // Flip V to image coordinates
 
-        auto i = int(u * image.width());
-        auto j = int(v * image.height());
-        auto pixel = image.pixel_data(i, j);
+        auto i = int(u * image->width());
+        auto j = int(v * image->height());
+        auto pixel = image->pixel_data(i, j);
 
         auto color_scale = 1.0 / 255.0;
         return color(color_scale * pixel[0], color_scale * pixel[1], color_scale * pixel[2]);
     }
 
 private:
-    rtw_image image;
+    shared_ptr<const rtw_image> image;
 };
 
 class noise_texture : public texture
@@ -0,0 +1,165 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// 工作窃取线程池
+// Persistent worker threads that execute indexed work items. Each worker owns a deque seeded
+// with a contiguous block of items (so neighbouring tiles stay on one core); it pops from the
+// front of its own deque and, once that runs dry, steals from the back of the other workers'.
+class thread_pool
+{
+public:
+    // thread_count <= 0 means one worker per hardware thread.
+    explicit thread_pool(int thread_count = 0)
+    {
+        thread_count = worker_count(thread_count);
+
+        for (int w = 0; w < thread_count; w++)
+            queues.push_back(std::unique_ptr<worker_queue>(new worker_queue()));
+
+        // The calling thread acts as worker 0, so only thread_count - 1 threads are spawned.
+        for (int w = 1; w < thread_count; w++)
+            threads.push_back(std::thread(&thread_pool::worker_loop, this, w));
+    }
+
+    // 按 thread_count 创建的线程池有多少个工作线程
+    static int worker_count(int thread_count)
+    {
+        if (thread_count <= 0)
+            thread_count = int(std::thread::hardware_concurrency());
+        return thread_count > 0 ? thread_count : 1;
+    }
+
+    ~thread_pool()
+    {
+        {
+            std::lock_guard<std::mutex> guard(job_lock);
+            stopping = true;
+        }
+        job_cv.notify_all();
+        for (auto &t : threads)
+            t.join();
+    }
+
+    thread_pool(const thread_pool &) = delete;
+    thread_pool &operator=(const thread_pool &) = delete;
+
+    int size() const { return int(queues.size()); }
+
+    // Runs body(item, worker) for every item in [0, item_count) and returns once all are done.
+    void parallel_for(int item_count, const std::function<void(int, int)> &body)
+    {
+        if (item_count <= 0)
+            return;
+
+        {
+            std::lock_guard<std::mutex> guard(job_lock);
+
+            int workers = size();
+            for (int w = 0; w < workers; w++)
+            {
+                int begin = int((long long)item_count * w / workers);
+                int end = int((long long)item_count * (w + 1) / workers);
+
+                std::lock_guard<std::mutex> queue_guard(queues[w]->lock);
+                for (int item = begin; item < end; item++)
+                    queues[w]->items.push_back(item);
+            }
+
+            job = &body;
+            busy_workers = int(threads.size());
+            generation++;
+        }
+        job_cv.notify_all();
+
+        run_items(0);
+
+        std::unique_lock<std::mutex> lock(job_lock);
+        done_cv.wait(lock, [this] { return busy_workers == 0; });
+        job = nullptr;
+    }
+
+private:
+    struct worker_queue
+    {
+        std::mutex lock;
+        std::deque<int> items;
+    };
+
+    std::vector<std::thread> threads;
+    std::vector<std::unique_ptr<worker_queue>> queues;
+
+    std::mutex job_lock;
+    std::condition_variable job_cv;  // 通知有新任务
+    std::condition_variable done_cv; // 通知任务完成
+    const std::function<void(int, int)> *job = nullptr;
+    unsigned long generation = 0;
+    int busy_workers = 0;
+    bool stopping = false;
+
+    void worker_loop(int worker)
+    {
+        unsigned long seen = 0;
+        while (true)
+        {
+            {
+                std::unique_lock<std::mutex> lock(job_lock);
+                job_cv.wait(lock, [&] { return stopping || generation != seen; });
+                if (stopping)
+                    return;
+                seen = generation;
+            }
+
+            run_items(worker);
+
+            {
+                std::lock_guard<std::mutex> guard(job_lock);
+                busy_workers--;
+            }
+            done_cv.notify_one();
+        }
+    }
+
+    void run_items(int worker)
+    {
+        int item;
+        while (pop_local(worker, item) || steal(worker, item))
+            (*job)(item, worker);
+    }
+
+    bool pop_local(int worker, int &item)
+    {
+        worker_queue &q = *queues[worker];
+        std::lock_guard<std::mutex> guard(q.lock);
+        if (q.items.empty())
+            return false;
+        item = q.items.front();
+        q.items.pop_front();
+        return true;
+    }
+
+    bool steal(int worker, int &item)
+    {
+        int workers = size();
+        for (int offset = 1; offset < workers; offset++)
+        {
+            worker_queue &victim = *queues[(worker + offset) % workers];
+            std::lock_guard<std::mutex> guard(victim.lock);
+            if (victim.items.empty())
+                continue;
+            item = victim.items.back();
+            victim.items.pop_back();
+            return true;
+        }
+        return false;
+    }
+};
+
+#endif
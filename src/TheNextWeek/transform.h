@@ -0,0 +1,175 @@
+#ifndef TRANSFORM_H
+#define TRANSFORM_H
+
+#include "rtweekend.h"
+#include "aabb.h"
+
+// 仿射变换
+// A 3x4 matrix (linear part plus translation) together with its inverse, so points and vectors
+// can be taken either way without inverting at hit time. Normals go through the inverse
+// transpose, which keeps them perpendicular to the surface under non-uniform scaling.
+class affine_transform
+{
+public:
+    affine_transform()
+    {
+        for (int r = 0; r < 3; r++)
+            for (int c = 0; c < 4; c++)
+                m[r][c] = inv[r][c] = (r == c) ? 1 : 0;
+    }
+
+    static affine_transform translation(const vec3 &offset)
+    {
+        affine_transform t;
+        for (int r = 0; r < 3; r++)
+        {
+            t.m[r][3] = offset[r];
+            t.inv[r][3] = -offset[r];
+        }
+        return t;
+    }
+
+    static affine_transform scaling(const vec3 &s)
+    {
+        affine_transform t;
+        for (int r = 0; r < 3; r++)
+        {
+            t.m[r][r] = s[r];
+            t.inv[r][r] = 1 / s[r];
+        }
+        return t;
+    }
+
+    // 绕过原点的 axis 轴旋转 degrees 度（右手定则），Rodrigues 公式
+    static affine_transform rotation(const vec3 &axis, double degrees)
+    {
+        vec3 a = unit_vector(axis);
+        double radians = degrees_to_radians(degrees);
+        double s = std::sin(radians), c = std::cos(radians);
+
+        affine_transform t;
+        for (int r = 0; r < 3; r++)
+            for (int col = 0; col < 3; col++)
+                t.m[r][col] = a[r] * a[col] * (1 - c) + (r == col ? c : 0);
+        t.m[0][1] -= a[2] * s;
+        t.m[0][2] += a[1] * s;
+        t.m[1][0] += a[2] * s;
+        t.m[1][2] -= a[0] * s;
+        t.m[2][0] -= a[1] * s;
+        t.m[2][1] += a[0] * s;
+
+        // 旋转矩阵的逆是它的转置
+        for (int r = 0; r < 3; r++)
+            for (int col = 0; col < 3; col++)
+                t.inv[r][col] = t.m[col][r];
+        return t;
+    }
+
+    static affine_transform rotation_y(double degrees) { return rotation(vec3(0, 1, 0), degrees); }
+
+    // (a * b) 先做 b 再做 a
+    affine_transform operator*(const affine_transform &b) const
+    {
+        affine_transform t;
+        multiply(m, b.m, t.m);
+        multiply(b.inv, inv, t.inv);
+        return t;
+    }
+
+    affine_transform inverse() const
+    {
+        affine_transform t;
+        for (int r = 0; r < 3; r++)
+        {
+            for (int c = 0; c < 4; c++)
+            {
+                t.m[r][c] = inv[r][c];
+                t.inv[r][c] = m[r][c];
+            }
+        }
+        return t;
+    }
+
+    point3 point(const point3 &p) const { return apply(m, p, 1); }
+    vec3 vector(const vec3 &v) const { return apply(m, v, 0); }
+    point3 inverse_point(const point3 &p) const { return apply(inv, p, 1); }
+    vec3 inverse_vector(const vec3 &v) const { return apply(inv, v, 0); }
+
+    // point(p) 的误差界，p 本身带有误差 p_error：原有的误差经 |M| 放大，再加上这次变换的舍入。
+    // The matrix arithmetic is double, but the result is rounded to real, so γ(3) of real covers
+    // both builds (PBRT 3.9.4).
+    vec3 point_error(const point3 &p, const vec3 &p_error) const
+    {
+        double g = error_gamma(3);
+        vec3 e;
+        for (int r = 0; r < 3; r++)
+        {
+            double carried = 0, magnitude = std::fabs(m[r][3]);
+            for (int c = 0; c < 3; c++)
+            {
+                carried += std::fabs(m[r][c]) * p_error[c];
+                magnitude += std::fabs(m[r][c] * p[c]);
+            }
+            e[r] = real((1 + g) * carried + g * magnitude);
+        }
+        return e;
+    }
+
+    // 法线乘以逆矩阵的转置；结果未归一化
+    vec3 normal(const vec3 &n) const
+    {
+        return vec3(inv[0][0] * n[0] + inv[1][0] * n[1] + inv[2][0] * n[2],
+                    inv[0][1] * n[0] + inv[1][1] * n[1] + inv[2][1] * n[2],
+                    inv[0][2] * n[0] + inv[1][2] * n[1] + inv[2][2] * n[2]);
+    }
+
+    // 变换后的包围盒：八个角点变换后的包围盒
+    aabb box(const aabb &b) const
+    {
+        point3 min(infinity, infinity, infinity);
+        point3 max(-infinity, -infinity, -infinity);
+        for (int i = 0; i < 2; i++)
+        {
+            for (int j = 0; j < 2; j++)
+            {
+                for (int k = 0; k < 2; k++)
+                {
+                    point3 corner = point(point3(i ? b.x.max : b.x.min, j ? b.y.max : b.y.min, k ? b.z.max : b.z.min));
+                    for (int c = 0; c < 3; c++)
+                    {
+                        min[c] = std::fmin(min[c], corner[c]);
+                        max[c] = std::fmax(max[c], corner[c]);
+                    }
+                }
+            }
+        }
+        return aabb(min, max);
+    }
+
+private:
+    double m[3][4];   // 物体空间 -> 世界空间
+    double inv[3][4]; // 世界空间 -> 物体空间
+
+    static vec3 apply(const double a[3][4], const vec3 &v, double w)
+    {
+        return vec3(a[0][0] * v[0] + a[0][1] * v[1] + a[0][2] * v[2] + a[0][3] * w,
+                    a[1][0] * v[0] + a[1][1] * v[1] + a[1][2] * v[2] + a[1][3] * w,
+                    a[2][0] * v[0] + a[2][1] * v[1] + a[2][2] * v[2] + a[2][3] * w);
+    }
+
+    // 3x4 仿射矩阵相乘，第四行隐含为 (0, 0, 0, 1)
+    static void multiply(const double a[3][4], const double b[3][4], double out[3][4])
+    {
+        for (int r = 0; r < 3; r++)
+        {
+            for (int c = 0; c < 4; c++)
+            {
+                out[r][c] = a[r][0] * b[0][c] + a[r][1] * b[1][c] + a[r][2] * b[2][c];
+                if (c == 3)
+                    out[r][c] += a[r][3];
+            }
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,463 @@
+#ifndef TRIANGLE_MESH_H
+#define TRIANGLE_MESH_H
+
+#include "rtweekend.h"
+#include "hittable.h"
+#include "material.h"
+#include "bvh_builder.h"
+#include "linear_bvh.h"
+#include "scene_cache.h"
+
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+// 三角网格的顶点数据
+// Every triangle has three position indices. Normals and texture coordinates either have index
+// arrays of their own, as in OBJ, or, when those are empty, are per vertex and share the position
+// indices, as in PLY. Values are stored as floats, which is ample for model data and halves the
+// footprint of large meshes.
+struct mesh_data
+{
+    std::vector<float> positions; // x, y, z
+    std::vector<float> normals;   // x, y, z; 可以为空
+    std::vector<float> uvs;       // u, v; 可以为空
+    std::vector<uint32_t> position_indices; // 每个三角形 3 个
+    std::vector<uint32_t> normal_indices;   // 与 position_indices 等长；为空时法线按顶点存放
+    std::vector<uint32_t> uv_indices;       // 与 position_indices 等长；为空时纹理坐标按顶点存放
+
+    size_t vertex_count() const { return positions.size() / 3; }
+    size_t triangle_count() const { return position_indices.size() / 3; }
+};
+
+// 三角网格
+// One hittable for a whole mesh with its own BVH (the bottom level when the mesh is placed with
+// an instance). Triangles are reordered into leaf order once at construction; traversal only
+// tracks the closest triangle and its barycentrics, and the hit_record is filled in once at the
+// end.
+//
+// The ray/triangle test is the watertight algorithm of Woop, Benthin and Wald ("Watertight
+// Ray/Triangle Intersection", JCGT 2013): vertices are sheared into a space where the ray runs
+// along +z and the edge functions are evaluated there, so a ray through a shared edge or vertex
+// hits exactly one of the triangles around it and never slips through the gap between them.
+// That relies on an edge function coming out with exactly the opposite sign for the triangle on
+// the other side of the edge, which fused multiply-adds break; the build turns off floating-point
+// contraction (-ffp-contract=off) for this reason.
+//
+// A built mesh can be saved to a cache file and later used straight from the mapped file: the
+// vertex, index and node arrays are read in place, so there is nothing to parse or build.
+//
+// A mesh is not a light source for next event estimation; an emissive mesh is only found by
+// scattered rays, like the contents of an instance.
+class triangle_mesh : public hittable
+{
+public:
+    triangle_mesh(mesh_data data, shared_ptr<material> mat, const bvh_build_options &options = bvh_build_options())
+        : mesh(std::move(data)), mat(std::move(mat))
+    {
+        drop_invalid_triangles();
+        point_view();
+
+        size_t count = mesh.triangle_count();
+        std::vector<aabb> boxes(count);
+        for (size_t i = 0; i < count; i++)
+        {
+            point3 a = vertex(mesh.position_indices[i * 3]);
+            point3 b = vertex(mesh.position_indices[i * 3 + 1]);
+            point3 c = vertex(mesh.position_indices[i * 3 + 2]);
+            boxes[i] = widen(aabb(aabb(a, b), aabb(c, c)));
+        }
+
+        bvh_builder builder(boxes, options);
+        auto root = builder.build();
+        nodes = linear_bvh(*root, builder.node_count());
+        bbox = count ? root->bbox : aabb::empty;
+        std::vector<aabb>().swap(boxes);
+
+        const std::vector<size_t> &order = builder.ordered_indices();
+        reorder(mesh.position_indices, order);
+        reorder(mesh.normal_indices, order);
+        reorder(mesh.uv_indices, order);
+        point_view();
+    }
+
+    // Uses a mesh saved by save_cache() in place. Returns nullptr when the file is missing, was
+    // written for other content (key) or by another format version, or is damaged: besides the
+    // section sizes, every index and BVH node is range-checked once, which is still far cheaper
+    // than parsing the model.
+    static shared_ptr<triangle_mesh> load_cache(const std::string &path, uint64_t key, shared_ptr<material> mat)
+    {
+        std::unique_ptr<cache_file> file(new cache_file());
+        if (!file->open(path, cache_triangle_mesh, key))
+            return nullptr;
+
+        shared_ptr<triangle_mesh> result(new triangle_mesh(std::move(mat)));
+        mesh_view &v = result->view;
+        size_t count, nodes;
+        linear_bvh_node *node_data;
+        double *bounds;
+        if (!file->section(section_positions, v.positions, count) || count % 3 != 0)
+            return nullptr;
+        v.vertex_count = count / 3;
+        if (!file->section(section_position_indices, v.position_indices, count) || count % 3 != 0)
+            return nullptr;
+        v.triangle_count = count / 3;
+        if (!file->section(section_normals, v.normals, v.normal_count) ||
+            !file->section(section_normal_indices, v.normal_indices, v.triangle_count * 3, true) ||
+            !attribute_valid(v.normals, v.normal_count, v.normal_indices, 3, v.vertex_count))
+            return nullptr;
+        if (!file->section(section_uvs, v.uvs, v.uv_count) ||
+            !file->section(section_uv_indices, v.uv_indices, v.triangle_count * 3, true) ||
+            !attribute_valid(v.uvs, v.uv_count, v.uv_indices, 2, v.vertex_count))
+            return nullptr;
+        if (!file->section(section_nodes, node_data, nodes) || !file->section(section_bounds, bounds, 6, false))
+            return nullptr;
+
+        result->nodes = linear_bvh::view(node_data, nodes);
+        if (!indices_valid(v.position_indices, v.triangle_count * 3, v.vertex_count) ||
+            !indices_valid(v.normal_indices, v.triangle_count * 3, v.normal_count / 3) ||
+            !indices_valid(v.uv_indices, v.triangle_count * 3, v.uv_count / 2) ||
+            !result->nodes.valid(v.triangle_count))
+            return nullptr;
+        result->bbox = v.triangle_count ? aabb(interval(bounds[0], bounds[1]), interval(bounds[2], bounds[3]), interval(bounds[4], bounds[5]))
+                                        : aabb::empty;
+        result->cache = std::move(file);
+        return result;
+    }
+
+    // 把顶点、索引和 BVH 写入缓存文件；key 标识生成它的内容
+    bool save_cache(const std::string &path, uint64_t key) const
+    {
+        double bounds[6] = {bbox.x.min, bbox.x.max, bbox.y.min, bbox.y.max, bbox.z.min, bbox.z.max};
+        cache_writer writer(cache_triangle_mesh, key);
+        writer.add(section_positions, view.positions, view.vertex_count * 3);
+        writer.add(section_normals, view.normals, view.normals ? view.normal_count : 0);
+        writer.add(section_uvs, view.uvs, view.uvs ? view.uv_count : 0);
+        writer.add(section_position_indices, view.position_indices, view.triangle_count * 3);
+        writer.add(section_normal_indices, view.normal_indices, view.normal_indices ? view.triangle_count * 3 : 0);
+        writer.add(section_uv_indices, view.uv_indices, view.uv_indices ? view.triangle_count * 3 : 0);
+        writer.add(section_nodes, nodes.data(), nodes.size());
+        writer.add(section_bounds, bounds, 6);
+        return writer.write(path);
+    }
+
+    bool hit(const ray &r, interval ray_t, hit_record &rec) const override
+    {
+        ray_shear shear(r);
+        uint32_t closest = 0;
+        real b0 = 0, b1 = 0, b2 = 0;
+        bool hit_anything = nodes.traverse(r, ray_t, [&](uint32_t first, uint32_t count, interval &leaf_t)
+        {
+            bool hit_leaf = false;
+            for (uint32_t i = first; i < first + count; i++)
+            {
+                real t, u, v, w;
+                if (hit_triangle(i, shear, leaf_t, t, u, v, w))
+                {
+                    leaf_t.max = t;
+                    closest = i;
+                    b0 = u;
+                    b1 = v;
+                    b2 = w;
+                    hit_leaf = true;
+                }
+            }
+            return hit_leaf;
+        });
+
+        if (!hit_anything)
+            return false;
+        set_record(closest, r, ray_t.max, b0, b1, b2, rec);
+        return true;
+    }
+
+    aabb bounding_box() const override { return bbox; }
+
+    size_t vertex_count() const { return view.vertex_count; }
+    size_t triangle_count() const { return view.triangle_count; }
+    bool from_cache() const { return cache != nullptr; }
+
+    // 顶点数据、索引和 BVH 节点占用的字节数（无论在内存中还是在映射的缓存文件中）
+    size_t memory_bytes() const
+    {
+        size_t index_arrays = 1 + (view.normal_indices != nullptr) + (view.uv_indices != nullptr);
+        return (view.vertex_count * 3 + (view.normals ? view.normal_count : 0) + (view.uvs ? view.uv_count : 0)) * sizeof(float) +
+               index_arrays * view.triangle_count * 3 * sizeof(uint32_t) + nodes.size() * sizeof(linear_bvh_node);
+    }
+
+private:
+    enum section_id : uint32_t
+    {
+        section_positions = 1,
+        section_normals,
+        section_uvs,
+        section_position_indices,
+        section_normal_indices,
+        section_uv_indices,
+        section_nodes,
+        section_bounds,
+    };
+
+    // The arrays traversal reads, in either mesh or the mapped cache file. Attribute pointers are
+    // null when absent; null index arrays mean the attribute is per vertex.
+    struct mesh_view
+    {
+        float *positions = nullptr, *normals = nullptr, *uvs = nullptr;
+        uint32_t *position_indices = nullptr, *normal_indices = nullptr, *uv_indices = nullptr;
+        size_t vertex_count = 0, triangle_count = 0;
+        size_t normal_count = 0, uv_count = 0; // 数组中的 float 个数
+    };
+
+    mesh_data mesh; // 从缓存读取时为空
+    std::unique_ptr<cache_file> cache;
+    mesh_view view;
+    shared_ptr<material> mat;
+    linear_bvh nodes;
+    aabb bbox;
+
+    explicit triangle_mesh(shared_ptr<material> mat) : mat(std::move(mat)) {}
+
+    // 属性或者不存在，或者有自己的索引，或者按顶点存放
+    static bool attribute_valid(const float *values, size_t count, const uint32_t *indices, size_t components, size_t vertex_count)
+    {
+        if (!values)
+            return !indices;
+        return count % components == 0 && (indices || count == vertex_count * components);
+    }
+
+    static bool indices_valid(const uint32_t *indices, size_t count, size_t limit)
+    {
+        if (!indices)
+            return true;
+        for (size_t i = 0; i < count; i++)
+        {
+            if (indices[i] >= limit)
+                return false;
+        }
+        return true;
+    }
+
+    template <typename T>
+    static T *data_or_null(std::vector<T> &values) { return values.empty() ? nullptr : values.data(); }
+
+    void point_view()
+    {
+        view.positions = data_or_null(mesh.positions);
+        view.normals = data_or_null(mesh.normals);
+        view.uvs = data_or_null(mesh.uvs);
+        view.position_indices = data_or_null(mesh.position_indices);
+        view.normal_indices = data_or_null(mesh.normal_indices);
+        view.uv_indices = data_or_null(mesh.uv_indices);
+        view.vertex_count = mesh.vertex_count();
+        view.triangle_count = mesh.triangle_count();
+        view.normal_count = mesh.normals.size();
+        view.uv_count = mesh.uvs.size();
+    }
+
+    // 每条光线只算一次的剪切变换：把光线方向变成 +z 轴
+    struct ray_shear
+    {
+        point3 origin;
+        int kx, ky, kz;
+        real sx, sy, sz;
+
+        explicit ray_shear(const ray &r) : origin(r.origin())
+        {
+            const vec3 &d = r.direction();
+            kz = std::fabs(d.x()) > std::fabs(d.y()) ? (std::fabs(d.x()) > std::fabs(d.z()) ? 0 : 2)
+                                                     : (std::fabs(d.y()) > std::fabs(d.z()) ? 1 : 2);
+            kx = kz == 2 ? 0 : kz + 1;
+            ky = kx == 2 ? 0 : kx + 1;
+            // Keep the winding: swapping x and y mirrors the projection when the ray points down z.
+            if (d[kz] < 0)
+                std::swap(kx, ky);
+            sx = d[kx] / d[kz];
+            sy = d[ky] / d[kz];
+            sz = 1 / d[kz];
+        }
+    };
+
+    point3 vertex(uint32_t index) const
+    {
+        const float *p = &view.positions[size_t(index) * 3];
+        return point3(p[0], p[1], p[2]);
+    }
+
+    // t 与 direction 的长度无关：剪切后的 z 以 d[kz] 为单位，和 ray::at() 一致
+    bool hit_triangle(uint32_t i, const ray_shear &s, const interval &ray_t, real &t, real &u, real &v, real &w) const
+    {
+        RT_STAT(thread_stats().primitive_tests++);
+        const uint32_t *index = &view.position_indices[size_t(i) * 3];
+        vec3 a = vertex(index[0]) - s.origin;
+        vec3 b = vertex(index[1]) - s.origin;
+        vec3 c = vertex(index[2]) - s.origin;
+
+        real ax = a[s.kx] - s.sx * a[s.kz], ay = a[s.ky] - s.sy * a[s.kz];
+        real bx = b[s.kx] - s.sx * b[s.kz], by = b[s.ky] - s.sy * b[s.kz];
+        real cx = c[s.kx] - s.sx * c[s.kz], cy = c[s.ky] - s.sy * c[s.kz];
+
+        // 三条边函数；同号（允许为 0）时光线穿过三角形
+        u = cx * by - cy * bx;
+        v = ax * cy - ay * cx;
+        w = bx * ay - by * ax;
+        if ((u < 0 || v < 0 || w < 0) && (u > 0 || v > 0 || w > 0))
+            return false;
+
+        real det = u + v + w;
+        if (det == 0)
+            return false;
+
+        real scaled_t = s.sz * (u * a[s.kz] + v * b[s.kz] + w * c[s.kz]);
+        t = scaled_t / det;
+        if (!ray_t.surrounds(t)) // 严格不等式，与 quad 相同
+            return false;
+
+        u /= det;
+        v /= det;
+        w /= det;
+        return true;
+    }
+
+    // b0, b1, b2 是三个顶点的重心坐标
+    void set_record(uint32_t i, const ray &r, real t, real b0, real b1, real b2, hit_record &rec) const
+    {
+        const uint32_t *index = &view.position_indices[size_t(i) * 3];
+        point3 p0 = vertex(index[0]), p1 = vertex(index[1]), p2 = vertex(index[2]);
+
+        rec.t = t;
+        // The barycentric point lies on the triangle itself, unlike r.at(t) which carries the
+        // rounding error of t along the ray.
+        rec.p = b0 * p0 + b1 * p1 + b2 * p2;
+        rec.p_error = error_gamma(7) * (abs(b0 * p0) + abs(b1 * p1) + abs(b2 * p2));
+        rec.mat_ptr = mat.get();
+        rec.object = this;
+        rec.set_face_normal(r, unit_vector(cross(p1 - p0, p2 - p0)));
+
+        if (view.normals)
+        {
+            const uint32_t *n = view.normal_indices ? &view.normal_indices[size_t(i) * 3] : index;
+            vec3 shading = b0 * attribute3(view.normals, n[0]) + b1 * attribute3(view.normals, n[1]) +
+                           b2 * attribute3(view.normals, n[2]);
+            // 着色法线翻到几何法线所在的一侧
+            if (shading.length_squared() > 0)
+            {
+                shading = unit_vector(shading);
+                if (dot(shading, rec.normal) < 0)
+                    shading = -shading;
+                // Spawned rays are offset along the shading normal, which only moves them
+                // cos(shading, geometric) as far off the plane; widen the error bound to make up
+                // for it (up to 10x for normals more than ~84 degrees apart).
+                rec.p_error *= 1 / std::max(dot(shading, rec.normal), real(0.1));
+                rec.normal = shading;
+            }
+        }
+
+        if (view.uvs)
+        {
+            const uint32_t *uv = view.uv_indices ? &view.uv_indices[size_t(i) * 3] : index;
+            rec.u = b0 * view.uvs[uv[0] * 2] + b1 * view.uvs[uv[1] * 2] + b2 * view.uvs[uv[2] * 2];
+            rec.v = b0 * view.uvs[uv[0] * 2 + 1] + b1 * view.uvs[uv[1] * 2 + 1] + b2 * view.uvs[uv[2] * 2 + 1];
+        }
+        else
+        {
+            rec.u = b1;
+            rec.v = b2;
+        }
+    }
+
+    // The box's faces pass exactly through the vertices, and the slab test's rounding can then
+    // reject a ray that hits a vertex or edge on the box boundary, undoing the watertight triangle
+    // test. Moving every face out by one float step keeps such rays inside the box.
+    static aabb widen(const aabb &box)
+    {
+        const float inf = std::numeric_limits<float>::infinity();
+        interval axes[3];
+        for (int a = 0; a < 3; a++)
+        {
+            const interval &range = box.axis_interval(a);
+            axes[a] = interval(std::nextafter(round_down_to_float(range.min), -inf), std::nextafter(round_up_to_float(range.max), inf));
+        }
+        return aabb(axes[0], axes[1], axes[2]);
+    }
+
+    static vec3 attribute3(const float *values, uint32_t index)
+    {
+        const float *p = &values[size_t(index) * 3];
+        return vec3(p[0], p[1], p[2]);
+    }
+
+    // 与 set_record 中的几何法线同样计算，叉积为零时 unit_vector 会得到 NaN
+    bool zero_area(const uint32_t *index) const
+    {
+        point3 p[3];
+        for (int k = 0; k < 3; k++)
+        {
+            const float *v = &mesh.positions[size_t(index[k]) * 3];
+            p[k] = point3(v[0], v[1], v[2]);
+        }
+        return cross(p[1] - p[0], p[2] - p[0]).length_squared() == 0;
+    }
+
+    // 去掉索引越界和面积为零的三角形（几何法线无法归一化）；法线或纹理坐标的数量对不上时整体丢弃
+    void drop_invalid_triangles()
+    {
+        size_t count = mesh.triangle_count();
+        mesh.position_indices.resize(count * 3);
+        if (mesh.normal_indices.empty() ? mesh.normals.size() != mesh.positions.size() : mesh.normal_indices.size() != count * 3)
+        {
+            mesh.normals.clear();
+            mesh.normal_indices.clear();
+        }
+        if (mesh.uv_indices.empty() ? mesh.uvs.size() / 2 != mesh.vertex_count() : mesh.uv_indices.size() != count * 3)
+        {
+            mesh.uvs.clear();
+            mesh.uv_indices.clear();
+        }
+
+        size_t kept = 0;
+        for (size_t i = 0; i < count; i++)
+        {
+            bool valid = true;
+            for (int k = 0; k < 3; k++)
+            {
+                valid = valid && mesh.position_indices[i * 3 + k] < mesh.vertex_count();
+                if (!mesh.normal_indices.empty())
+                    valid = valid && size_t(mesh.normal_indices[i * 3 + k]) * 3 < mesh.normals.size();
+                if (!mesh.uv_indices.empty())
+                    valid = valid && size_t(mesh.uv_indices[i * 3 + k]) * 2 < mesh.uvs.size();
+            }
+            if (!valid || zero_area(&mesh.position_indices[i * 3]))
+                continue;
+            for (int k = 0; k < 3; k++)
+            {
+                mesh.position_indices[kept * 3 + k] = mesh.position_indices[i * 3 + k];
+                if (!mesh.normal_indices.empty())
+                    mesh.normal_indices[kept * 3 + k] = mesh.normal_indices[i * 3 + k];
+                if (!mesh.uv_indices.empty())
+                    mesh.uv_indices[kept * 3 + k] = mesh.uv_indices[i * 3 + k];
+            }
+            kept++;
+        }
+        mesh.position_indices.resize(kept * 3);
+        if (!mesh.normal_indices.empty())
+            mesh.normal_indices.resize(kept * 3);
+        if (!mesh.uv_indices.empty())
+            mesh.uv_indices.resize(kept * 3);
+    }
+
+    // 按叶节点顺序重排每个三角形的三个索引
+    static void reorder(std::vector<uint32_t> &indices, const std::vector<size_t> &order)
+    {
+        if (indices.empty())
+            return;
+        std::vector<uint32_t> sorted(indices.size());
+        for (size_t i = 0; i < order.size(); i++)
+            for (int k = 0; k < 3; k++)
+                sorted[i * 3 + k] = indices[order[i] * 3 + k];
+        indices.swap(sorted);
+    }
+};
+
+#endif
@@ -1,24 +1,32 @@
 #pragma once
 #ifndef VEC3_H
-#define Vec3_H
+#define VEC3_H
 
-class vec3
+// 三维向量，按标量类型 T 模板化；渲染器用的是 vec3 = basic_vec3<real>
+template <typename T>
+class basic_vec3
 {
 public:
-    double e[3];
+    typedef T value_type;
 
-    vec3() : e{0, 0, 0} {}
-    vec3(double e0, double e1, double e2) : e{e0, e1, e2} {}
+    T e[3];
 
-    double x() const { return e[0]; }
-    double y() const { return e[1]; }
-    double z() const { return e[2]; }
+    basic_vec3() : e{0, 0, 0} {}
+    basic_vec3(T e0, T e1, T e2) : e{e0, e1, e2} {}
 
-    vec3 operator-() const { return vec3(-e[0], -e[1], -e[2]); }
-    double operator[](int i) const { return e[i]; }
-    double &operator[](int i) { return e[i]; }
+    // 不同精度之间显式转换
+    template <typename U>
+    explicit basic_vec3(const basic_vec3<U> &v) : e{T(v.e[0]), T(v.e[1]), T(v.e[2])} {}
 
-    vec3 &operator+=(const vec3 &v)
+    T x() const { return e[0]; }
+    T y() const { return e[1]; }
+    T z() const { return e[2]; }
+
+    basic_vec3 operator-() const { return basic_vec3(-e[0], -e[1], -e[2]); }
+    T operator[](int i) const { return e[i]; }
+    T &operator[](int i) { return e[i]; }
+
+    basic_vec3 &operator+=(const basic_vec3 &v)
     {
         e[0] += v.e[0];
         e[1] += v.e[1];
@@ -26,7 +34,7 @@ public:
         return *this;
     }
 
-    vec3 &operator*=(double t)
+    basic_vec3 &operator*=(T t)
     {
         e[0] *= t;
         e[1] *= t;
@@ -34,17 +42,17 @@ public:
         return *this;
     }
 
-    vec3 &operator/=(double t)
+    basic_vec3 &operator/=(T t)
     {
         return *this *= 1 / t;
     }
 
-    double length() const
+    T length() const
     {
         return sqrt(length_squared());
     }
 
-    double length_squared() const
+    T length_squared() const
     {
         return e[0] * e[0] + e[1] * e[1] + e[2] * e[2];
     }
@@ -52,78 +60,98 @@ public:
     bool near_zero() const
     {
         // Return true if the vector is close to zero in all dimensions.
-        auto s = 1e-8;
+        auto s = T(1e-8);
         return (fabs(e[0]) < s) && (fabs(e[1]) < s) && (fabs(e[2]) < s);
     }
 
-    static vec3 random()
+    static basic_vec3 random()
     {
-        return vec3(random_double(), random_double(), random_double());
+        return basic_vec3(T(random_double()), T(random_double()), T(random_double()));
     }
 
-    static vec3 random(double min, double max)
+    static basic_vec3 random(double min, double max)
     {
-        return vec3(random_double(min, max), random_double(min, max), random_double(min, max));
+        return basic_vec3(T(random_double(min, max)), T(random_double(min, max)), T(random_double(min, max)));
     }
 };
 
+typedef basic_vec3<real> vec3;
+
 // point3 is just an alias for vec3, but useful for geometric clarity in the code.
 using point3 = vec3;
 
 // Vector Utility Functions
+// 标量参数写成 basic_vec3<T>::value_type，T 只从向量推导，2.0 * v 这样的写法在 float 构建中照样可用
 
-inline std::ostream &operator<<(std::ostream &out, const vec3 &v)
+template <typename T>
+inline std::ostream &operator<<(std::ostream &out, const basic_vec3<T> &v)
 {
     return out << v.e[0] << ' ' << v.e[1] << ' ' << v.e[2];
 }
 
-inline vec3 operator+(const vec3 &u, const vec3 &v)
+template <typename T>
+inline basic_vec3<T> operator+(const basic_vec3<T> &u, const basic_vec3<T> &v)
 {
-    return vec3(u.e[0] + v.e[0], u.e[1] + v.e[1], u.e[2] + v.e[2]);
+    return basic_vec3<T>(u.e[0] + v.e[0], u.e[1] + v.e[1], u.e[2] + v.e[2]);
 }
 
-inline vec3 operator-(const vec3 &u, const vec3 &v)
+template <typename T>
+inline basic_vec3<T> operator-(const basic_vec3<T> &u, const basic_vec3<T> &v)
 {
-    return vec3(u.e[0] - v.e[0], u.e[1] - v.e[1], u.e[2] - v.e[2]);
+    return basic_vec3<T>(u.e[0] - v.e[0], u.e[1] - v.e[1], u.e[2] - v.e[2]);
 }
 
-inline vec3 operator*(const vec3 &u, const vec3 &v)
+template <typename T>
+inline basic_vec3<T> operator*(const basic_vec3<T> &u, const basic_vec3<T> &v)
 {
-    return vec3(u.e[0] * v.e[0], u.e[1] * v.e[1], u.e[2] * v.e[2]);
+    return basic_vec3<T>(u.e[0] * v.e[0], u.e[1] * v.e[1], u.e[2] * v.e[2]);
 }
 
-inline vec3 operator*(double t, const vec3 &v)
+template <typename T>
+inline basic_vec3<T> operator*(typename basic_vec3<T>::value_type t, const basic_vec3<T> &v)
 {
-    return vec3(t * v.e[0], t * v.e[1], t * v.e[2]);
+    return basic_vec3<T>(t * v.e[0], t * v.e[1], t * v.e[2]);
 }
 
-inline vec3 operator*(const vec3 &v, double t)
+template <typename T>
+inline basic_vec3<T> operator*(const basic_vec3<T> &v, typename basic_vec3<T>::value_type t)
 {
     return t * v;
 }
 
-inline vec3 operator/(const vec3 &v, double t)
+template <typename T>
+inline basic_vec3<T> operator/(const basic_vec3<T> &v, typename basic_vec3<T>::value_type t)
 {
     return (1 / t) * v;
 }
 
-inline double dot(const vec3 &u, const vec3 &v)
+template <typename T>
+inline T dot(const basic_vec3<T> &u, const basic_vec3<T> &v)
 {
     return u.e[0] * v.e[0] + u.e[1] * v.e[1] + u.e[2] * v.e[2];
 }
 
-inline vec3 cross(const vec3 &u, const vec3 &v)
+template <typename T>
+inline basic_vec3<T> cross(const basic_vec3<T> &u, const basic_vec3<T> &v)
 {
-    return vec3(u.e[1] * v.e[2] - u.e[2] * v.e[1],
-                u.e[2] * v.e[0] - u.e[0] * v.e[2],
-                u.e[0] * v.e[1] - u.e[1] * v.e[0]);
+    return basic_vec3<T>(u.e[1] * v.e[2] - u.e[2] * v.e[1],
+                         u.e[2] * v.e[0] - u.e[0] * v.e[2],
+                         u.e[0] * v.e[1] - u.e[1] * v.e[0]);
 }
 
-inline vec3 unit_vector(const vec3 &v)
+template <typename T>
+inline basic_vec3<T> unit_vector(const basic_vec3<T> &v)
 {
     return v / v.length();
 }
 
+// 各分量取绝对值，用于误差界的计算
+template <typename T>
+inline basic_vec3<T> abs(const basic_vec3<T> &v)
+{
+    return basic_vec3<T>(fabs(v.e[0]), fabs(v.e[1]), fabs(v.e[2]));
+}
+
 inline vec3 random_in_unit_disk()
 {
     while (true)
@@ -144,9 +172,13 @@ inline vec3 random_in_unit_sphere()
     }
 }
 
+// 球面上的均匀分布，直接由两个均匀数变换得到（z 均匀、方位角均匀），恰好用掉采样器的一对维
 inline vec3 random_unit_vector()
 {
-    return unit_vector(random_in_unit_sphere());
+    auto z = 1 - 2 * random_double();
+    auto phi = 2 * pi * random_double();
+    auto r = std::sqrt(std::max(0.0, 1 - z * z));
+    return vec3(r * std::cos(phi), r * std::sin(phi), z);
 }
 
 inline vec3 random_on_hemisphere(const vec3 &normal)
@@ -158,22 +190,24 @@ inline vec3 random_on_hemisphere(const vec3 &normal)
         return -on_unit_sphere;
 }
 
-inline vec3 reflect(const vec3 &v, const vec3 &n)
+template <typename T>
+inline basic_vec3<T> reflect(const basic_vec3<T> &v, const basic_vec3<T> &n)
 {
     return v - 2 * dot(v, n) * n;
 }
 
 // 计算折射向量的函数
-inline vec3 refract(const vec3 &uv, const vec3 &n, double etai_over_etat)
+template <typename T>
+inline basic_vec3<T> refract(const basic_vec3<T> &uv, const basic_vec3<T> &n, double etai_over_etat)
 {
     // 计算入射向量与法线之间的夹角的余弦值，并取其最小值以确保数值稳定性
-    auto cos_theta = fmin(dot(-uv, n), 1.0);
+    T cos_theta = std::min(dot(-uv, n), T(1));
     // 计算垂直于法线的折射分量
-    vec3 r_out_perp = etai_over_etat * (uv + cos_theta * n);
+    basic_vec3<T> r_out_perp = T(etai_over_etat) * (uv + cos_theta * n);
     // 计算平行于法线的折射分量
-    vec3 r_out_parallel = -sqrt(fabs(1.0 - r_out_perp.length_squared())) * n;
+    basic_vec3<T> r_out_parallel = -sqrt(fabs(1 - r_out_perp.length_squared())) * n;
     // 返回完整的折射向量
     return r_out_perp + r_out_parallel;
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,362 @@
+#ifndef WIDE_BVH_H
+#define WIDE_BVH_H
+
+#include "rtweekend.h"
+#include "aabb.h"
+#include "hittable.h"
+#include "hittable_list.h"
+#include "bvh_builder.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define WIDE_BVH_SSE
+#endif
+
+// 多叉 BVH 节点
+// Child bounds are stored structure-of-arrays so one SIMD sequence slab-tests the ray against
+// every child. An unused slot has inverted (+inf, -inf) bounds and can never be hit.
+template <int Width>
+struct wide_bvh_node
+{
+    float min_x[Width], min_y[Width], min_z[Width];
+    float max_x[Width], max_y[Width], max_z[Width];
+    uint32_t child[Width]; // interior: node index; leaf: first primitive
+    uint32_t count[Width]; // primitives in a leaf child, 0 for an interior child
+};
+
+// Ray data for the wide slab test, computed once per ray: single-precision origin and reciprocal
+// direction, plus the sign of each direction component to pick the near/far planes.
+struct wide_ray
+{
+    float org[3];
+    float inv_dir[3];
+    int dir_is_neg[3];
+
+    explicit wide_ray(const ray &r)
+    {
+        for (int axis = 0; axis < 3; axis++)
+        {
+            org[axis] = float(r.origin()[axis]);
+            inv_dir[axis] = float(1.0 / r.direction()[axis]);
+            dir_is_neg[axis] = inv_dir[axis] < 0; // 分量为 -0 时 inv_dir 是 -inf，要按它的符号选近、远平面
+        }
+    }
+};
+
+// BVH4 / BVH8: the binary SAH tree from bvh_builder collapsed into Width-ary nodes by repeatedly
+// opening the child with the largest surface area.
+template <int Width>
+class wide_bvh : public hittable
+{
+    static_assert(Width == 4 || Width == 8, "wide_bvh supports 4- and 8-wide nodes");
+
+public:
+    typedef wide_bvh_node<Width> node_type;
+
+    wide_bvh(hittable_list list, const bvh_build_options &options = bvh_build_options())
+    {
+        std::vector<aabb> boxes;
+        boxes.reserve(list.objects.size());
+        for (const auto &object : list.objects)
+            boxes.push_back(object->bounding_box());
+
+        bvh_builder builder(boxes, options);
+        auto root = builder.build();
+        bbox = root->bbox;
+
+        objects.reserve(list.objects.size());
+        primitives.reserve(list.objects.size());
+        for (auto index : builder.ordered_indices())
+        {
+            objects.push_back(list.objects[index]);
+            primitives.push_back(list.objects[index].get());
+        }
+
+        if (root->is_leaf())
+        {
+            // Wrap a single leaf in a node so traversal always starts from nodes[0].
+            if (root->count == 0)
+                return;
+            nodes.push_back(empty_node());
+            set_child(nodes[0], 0, *root, 0);
+        }
+        else
+            collapse(*root);
+    }
+
+    bool hit(const ray &r, interval ray_t, hit_record &rec) const override
+    {
+        if (nodes.empty())
+            return false;
+
+        wide_ray wr(r);
+
+        struct stack_entry
+        {
+            uint32_t child;
+            uint32_t count;
+            float t_near;
+        };
+        stack_entry stack[stack_capacity];
+        int stack_top = 0;
+        stack[stack_top++] = stack_entry{0, 0, -std::numeric_limits<float>::infinity()};
+
+        bool hit_anything = false;
+        while (stack_top > 0)
+        {
+            stack_entry entry = stack[--stack_top];
+            if (entry.t_near > ray_t.max)
+                continue; // something closer was found after this entry was pushed
+
+            if (entry.count > 0)
+            {
+                for (uint32_t i = entry.child; i < entry.child + entry.count; i++)
+                {
+                    if (primitives[i]->hit(r, ray_t, rec))
+                    {
+                        hit_anything = true;
+                        ray_t.max = rec.t;
+                    }
+                }
+                continue;
+            }
+
+            const node_type &n = nodes[entry.child];
+            float t_near[Width];
+            unsigned mask = intersect_children(n, wr, ray_t, t_near);
+
+            // Push hit children far-to-near so the nearest is popped first.
+            int order[Width];
+            int hits = 0;
+            for (int c = 0; c < Width; c++)
+            {
+                if (!(mask & (1u << c)))
+                    continue;
+                int k = hits++;
+                while (k > 0 && t_near[order[k - 1]] < t_near[c])
+                {
+                    order[k] = order[k - 1];
+                    k--;
+                }
+                order[k] = c;
+            }
+            for (int k = 0; k < hits; k++)
+            {
+                int c = order[k];
+                stack[stack_top++] = stack_entry{n.child[c], n.count[c], t_near[c]};
+            }
+        }
+
+        return hit_anything;
+    }
+
+    void collect_emitters(std::vector<const hittable *> &emitters) const override
+    {
+        for (auto primitive : primitives)
+            primitive->collect_emitters(emitters);
+    }
+
+    aabb bounding_box() const override { return bbox; }
+
+    size_t node_count() const { return nodes.size(); }
+
+    // Slab test of one ray against all Width children of a node. Returns a bit mask of the
+    // children whose box overlaps ray_t and writes each child's entry distance to t_near.
+    static unsigned intersect_children(const node_type &n, const wide_ray &wr, const interval &ray_t, float *t_near)
+    {
+        RT_STAT(thread_stats().node_visits++; thread_stats().box_tests += Width);
+        // Near/far planes per axis chosen once from the ray's direction signs.
+        const float *near_x = wr.dir_is_neg[0] ? n.max_x : n.min_x;
+        const float *far_x = wr.dir_is_neg[0] ? n.min_x : n.max_x;
+        const float *near_y = wr.dir_is_neg[1] ? n.max_y : n.min_y;
+        const float *far_y = wr.dir_is_neg[1] ? n.min_y : n.max_y;
+        const float *near_z = wr.dir_is_neg[2] ? n.max_z : n.min_z;
+        const float *far_z = wr.dir_is_neg[2] ? n.min_z : n.max_z;
+
+        float t_min = round_down_to_float(ray_t.min);
+        float t_max = round_up_to_float(ray_t.max);
+
+#if defined(__AVX__)
+        if (Width == 8)
+            return slab_avx(0, near_x, far_x, near_y, far_y, near_z, far_z, wr, t_min, t_max, t_near);
+#endif
+#if defined(__AVX__) || defined(WIDE_BVH_SSE)
+        unsigned mask = 0;
+        for (int base = 0; base < Width; base += 4)
+            mask |= slab_sse(base, near_x, far_x, near_y, far_y, near_z, far_z, wr, t_min, t_max, t_near) << base;
+        return mask;
+#else
+        unsigned mask = 0;
+        for (int c = 0; c < Width; c++)
+        {
+            float tx0 = (near_x[c] - wr.org[0]) * wr.inv_dir[0];
+            float tx1 = (far_x[c] - wr.org[0]) * wr.inv_dir[0];
+            float ty0 = (near_y[c] - wr.org[1]) * wr.inv_dir[1];
+            float ty1 = (far_y[c] - wr.org[1]) * wr.inv_dir[1];
+            float tz0 = (near_z[c] - wr.org[2]) * wr.inv_dir[2];
+            float tz1 = (far_z[c] - wr.org[2]) * wr.inv_dir[2];
+            // Written as (x > y ? x : y) so a NaN from 0 * inf falls back to the ray interval,
+            // matching the SIMD max/min semantics.
+            float t0 = tz0 > t_min ? tz0 : t_min;
+            t0 = ty0 > t0 ? ty0 : t0;
+            t0 = tx0 > t0 ? tx0 : t0;
+            float t1 = tz1 < t_max ? tz1 : t_max;
+            t1 = ty1 < t1 ? ty1 : t1;
+            t1 = tx1 < t1 ? tx1 : t1;
+            t_near[c] = t0;
+            if (t0 <= t1 * far_scale)
+                mask |= 1u << c;
+        }
+        return mask;
+#endif
+    }
+
+private:
+    // Depth of a collapsed tree times (Width - 1) pending siblings, with generous headroom.
+    static const int stack_capacity = 64 * Width;
+    std::vector<node_type> nodes;
+    std::vector<const hittable *> primitives;  // leaf order, non-owning
+    std::vector<shared_ptr<hittable>> objects; // keeps the primitives alive
+    aabb bbox;
+
+    // The ray origin and bounds are rounded to float, so stretch the exit distance by a few ulps
+    // to keep the test conservative (see PBRT's robust ray-bounds intersection).
+    static constexpr float far_scale = 1.0f + 2.0f * 3.0f * 0.5f * std::numeric_limits<float>::epsilon();
+
+#if defined(__AVX__)
+    static unsigned slab_avx(int base, const float *near_x, const float *far_x, const float *near_y, const float *far_y,
+                             const float *near_z, const float *far_z, const wide_ray &wr, float t_min, float t_max, float *t_near)
+    {
+        __m256 ox = _mm256_set1_ps(wr.org[0]), oy = _mm256_set1_ps(wr.org[1]), oz = _mm256_set1_ps(wr.org[2]);
+        __m256 ix = _mm256_set1_ps(wr.inv_dir[0]), iy = _mm256_set1_ps(wr.inv_dir[1]), iz = _mm256_set1_ps(wr.inv_dir[2]);
+
+        __m256 tx0 = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(near_x + base), ox), ix);
+        __m256 tx1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(far_x + base), ox), ix);
+        __m256 ty0 = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(near_y + base), oy), iy);
+        __m256 ty1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(far_y + base), oy), iy);
+        __m256 tz0 = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(near_z + base), oz), iz);
+        __m256 tz1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(far_z + base), oz), iz);
+
+        // max/min return the second operand when either is NaN, so the ray interval goes last.
+        __m256 t0 = _mm256_max_ps(tx0, _mm256_max_ps(ty0, _mm256_max_ps(tz0, _mm256_set1_ps(t_min))));
+        __m256 t1 = _mm256_min_ps(tx1, _mm256_min_ps(ty1, _mm256_min_ps(tz1, _mm256_set1_ps(t_max))));
+        t1 = _mm256_mul_ps(t1, _mm256_set1_ps(far_scale));
+
+        _mm256_storeu_ps(t_near + base, t0);
+        return unsigned(_mm256_movemask_ps(_mm256_cmp_ps(t0, t1, _CMP_LE_OQ)));
+    }
+#endif
+
+#if defined(__AVX__) || defined(WIDE_BVH_SSE)
+    static unsigned slab_sse(int base, const float *near_x, const float *far_x, const float *near_y, const float *far_y,
+                             const float *near_z, const float *far_z, const wide_ray &wr, float t_min, float t_max, float *t_near)
+    {
+        __m128 ox = _mm_set1_ps(wr.org[0]), oy = _mm_set1_ps(wr.org[1]), oz = _mm_set1_ps(wr.org[2]);
+        __m128 ix = _mm_set1_ps(wr.inv_dir[0]), iy = _mm_set1_ps(wr.inv_dir[1]), iz = _mm_set1_ps(wr.inv_dir[2]);
+
+        __m128 tx0 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(near_x + base), ox), ix);
+        __m128 tx1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(far_x + base), ox), ix);
+        __m128 ty0 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(near_y + base), oy), iy);
+        __m128 ty1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(far_y + base), oy), iy);
+        __m128 tz0 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(near_z + base), oz), iz);
+        __m128 tz1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(far_z + base), oz), iz);
+
+        __m128 t0 = _mm_max_ps(tx0, _mm_max_ps(ty0, _mm_max_ps(tz0, _mm_set1_ps(t_min))));
+        __m128 t1 = _mm_min_ps(tx1, _mm_min_ps(ty1, _mm_min_ps(tz1, _mm_set1_ps(t_max))));
+        t1 = _mm_mul_ps(t1, _mm_set1_ps(far_scale));
+
+        _mm_storeu_ps(t_near + base, t0);
+        return unsigned(_mm_movemask_ps(_mm_cmple_ps(t0, t1)));
+    }
+#endif
+
+    static node_type empty_node()
+    {
+        node_type n;
+        const float inf = std::numeric_limits<float>::infinity();
+        for (int c = 0; c < Width; c++)
+        {
+            n.min_x[c] = n.min_y[c] = n.min_z[c] = inf;
+            n.max_x[c] = n.max_y[c] = n.max_z[c] = -inf;
+            n.child[c] = 0;
+            n.count[c] = 0;
+        }
+        return n;
+    }
+
+    static void set_child(node_type &n, int slot, const bvh_build_node &child, uint32_t node_index)
+    {
+        n.min_x[slot] = round_down_to_float(child.bbox.x.min);
+        n.min_y[slot] = round_down_to_float(child.bbox.y.min);
+        n.min_z[slot] = round_down_to_float(child.bbox.z.min);
+        n.max_x[slot] = round_up_to_float(child.bbox.x.max);
+        n.max_y[slot] = round_up_to_float(child.bbox.y.max);
+        n.max_z[slot] = round_up_to_float(child.bbox.z.max);
+        if (child.is_leaf())
+        {
+            n.child[slot] = uint32_t(child.first);
+            n.count[slot] = uint32_t(child.count);
+        }
+        else
+        {
+            n.child[slot] = node_index;
+            n.count[slot] = 0;
+        }
+    }
+
+    // Emits the wide node for an interior build node and returns its index.
+    uint32_t collapse(const bvh_build_node &build)
+    {
+        // Open the largest interior child until the node is full.
+        const bvh_build_node *children[Width];
+        int child_count = 0;
+        children[child_count++] = build.left.get();
+        children[child_count++] = build.right.get();
+        while (child_count < Width)
+        {
+            int largest = -1;
+            double largest_area = -1;
+            for (int c = 0; c < child_count; c++)
+            {
+                if (children[c]->is_leaf())
+                    continue;
+                double area = children[c]->bbox.surface_area();
+                if (area > largest_area)
+                {
+                    largest_area = area;
+                    largest = c;
+                }
+            }
+            if (largest < 0)
+                break;
+
+            const bvh_build_node *opened = children[largest];
+            children[largest] = opened->left.get();
+            children[child_count++] = opened->right.get();
+        }
+
+        uint32_t index = uint32_t(nodes.size());
+        nodes.push_back(empty_node());
+        for (int c = 0; c < child_count; c++)
+        {
+            uint32_t child_index = children[c]->is_leaf() ? 0 : collapse(*children[c]);
+            set_child(nodes[index], c, *children[c], child_index);
+        }
+        return index;
+    }
+};
+
+template <int Width>
+constexpr float wide_bvh<Width>::far_scale;
+
+using bvh4 = wide_bvh<4>;
+using bvh8 = wide_bvh<8>;
+
+#endif